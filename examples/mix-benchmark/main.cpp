@@ -0,0 +1,162 @@
+#include <wpn114audio/mix.hpp>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+// micro-benchmark: Connection::pull mixing loop, former scalar version vs vectorized kernels
+// usage: mix-benchmark [iterations]
+
+using cable = std::array<uint8_t, 2>;
+using clk = std::chrono::steady_clock;
+
+//-------------------------------------------------------------------------------------------------
+static void
+reference(sample_t** dbuf, sample_t** sbuf, std::vector<cable> const& routing,
+          uint8_t nchannels, sample_t mul, sample_t add, vector_t nframes)
+// the former Connection::pull loop
+//-------------------------------------------------------------------------------------------------
+{
+    if (routing.empty())
+        for (uint8_t c = 0; c < nchannels; ++c)
+            for (vector_t f = 0; f < nframes; ++f)
+                dbuf[c][f] += sbuf[c][f] * mul + add;
+    else
+        for (uint8_t c = 0; c < routing.size(); ++c)
+            for (vector_t f = 0; f < nframes; ++f) {
+                auto cable = routing[c];
+                dbuf[cable[1]][f] += sbuf[cable[0]][f] * mul + add;
+            }
+}
+
+//-------------------------------------------------------------------------------------------------
+static std::vector<cable>
+compile(std::vector<cable> const& routing, uint8_t nchannels)
+// implicit routings are expanded in the plan's cable table
+//-------------------------------------------------------------------------------------------------
+{
+    if (!routing.empty())
+        return routing;
+
+    std::vector<cable> cables;
+    for (uint8_t c = 0; c < nchannels; ++c)
+         cables.push_back({ c, c });
+
+    return cables;
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+kernel(sample_t** dbuf, sample_t** sbuf, cable const* cables, uint8_t ncables,
+       sample_t mul, sample_t add, vector_t nframes, wpn114::mix::kernel k)
+// the current Connection::pull loop
+//-------------------------------------------------------------------------------------------------
+{
+    for (uint8_t c = 0; c < ncables; ++c)
+         k(dbuf[cables[c][1]], sbuf[cables[c][0]], mul, add, nframes);
+}
+
+//-------------------------------------------------------------------------------------------------
+struct buffers
+//-------------------------------------------------------------------------------------------------
+{
+    buffers(uint8_t nchannels, vector_t nframes) :
+        data(nchannels*nframes), channels(nchannels)
+    {
+        for (uint8_t c = 0; c < nchannels; ++c)
+             channels[c] = &data[c*nframes];
+    }
+
+    std::vector<sample_t> data;
+    std::vector<sample_t*> channels;
+};
+
+//-------------------------------------------------------------------------------------------------
+template<typename F> static double
+measure(F&& f, size_t iterations)
+// returns nanoseconds per call
+//-------------------------------------------------------------------------------------------------
+{
+    auto begin = clk::now();
+    for (size_t n = 0; n < iterations; ++n)
+         f();
+    auto end = clk::now();
+
+    return std::chrono::duration<double, std::nano>(end-begin).count()/iterations;
+}
+
+//-------------------------------------------------------------------------------------------------
+int
+main(int argc, char** argv)
+//-------------------------------------------------------------------------------------------------
+{
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    uint8_t const nchannels = 8;
+
+    struct setup { const char* name; sample_t mul, add; bool routed; };
+    setup const setups[] = {
+        { "unity, identity",    1.f,    0.f,    false },
+        { "gain, identity",     .5f,    0.f,    false },
+        { "gain+add, identity", .5f,    .125f,  false },
+        { "gain, cables",       .5f,    0.f,    true  },
+    };
+
+    std::vector<cable> cables, identity;
+    for (uint8_t c = 0; c < nchannels; ++c)
+         cables.push_back({ c, static_cast<uint8_t>((c+3) % nchannels) });
+
+    std::printf("cpu: %s, %u channels, %zu iterations\n",
+                wpn114::mix::name(wpn114::mix::current()), nchannels, iterations);
+
+    for (vector_t nframes : { 64, 256, 1024, 1023 })
+    for (auto& setup : setups)
+    {
+        auto const& routing = setup.routed ? cables : identity;
+        auto variant = wpn114::mix::select(setup.mul, setup.add);
+        auto compiled = compile(routing, nchannels);
+        auto ncables = static_cast<uint8_t>(compiled.size());
+
+        buffers source(nchannels, nframes), expected(nchannels, nframes);
+        for (auto& s : source.data)
+             s = static_cast<sample_t>(std::rand())/RAND_MAX*2-1;
+
+        reference(expected.channels.data(), source.channels.data(), routing,
+                  nchannels, setup.mul, setup.add, nframes);
+
+        buffers dest(nchannels, nframes);
+        auto tref = measure([&] {
+            reference(dest.channels.data(), source.channels.data(), routing,
+                      nchannels, setup.mul, setup.add, nframes);
+        }, iterations);
+
+        std::printf("%5u frames, %-20s reference %9.1f ns\n", nframes, setup.name, tref);
+
+        for (auto target : { wpn114::mix::isa::Scalar, wpn114::mix::isa::SSE2,
+                             wpn114::mix::isa::AVX2, wpn114::mix::isa::AVX512 })
+        {
+            auto k = wpn114::mix::get(variant, target);
+            if (k == nullptr)
+                continue;
+
+            // output has to be identical to the reference loop
+            buffers check(nchannels, nframes);
+            kernel(check.channels.data(), source.channels.data(), compiled.data(),
+                   ncables, setup.mul, setup.add, nframes, k);
+
+            bool identical = std::memcmp(check.data.data(), expected.data.data(),
+                                         check.data.size()*sizeof(sample_t)) == 0;
+
+            auto t = measure([&] {
+                kernel(dest.channels.data(), source.channels.data(), compiled.data(),
+                       ncables, setup.mul, setup.add, nframes, k);
+            }, iterations);
+
+            std::printf("%34s %-7s %9.1f ns  x%.2f %s\n", "", wpn114::mix::name(target),
+                        t, tref/t, identical ? "" : "(output mismatch!)");
+        }
+    }
+
+    return 0;
+}
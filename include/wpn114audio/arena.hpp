@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+    #include <malloc.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+namespace wpn114
+{
+
+// ================================================================================================
+class arena
+// a single contiguous, cache-line aligned block of memory
+// holding all of the Graph's audio Port buffers
+// it is allocated (and touched) outside of the audio thread, and never resized:
+// a new arena is built whenever the buffer layout changes
+// ================================================================================================
+{
+
+public:
+
+    // --------------------------------------------------------------------------------------------
+    static constexpr size_t
+    alignment = 64;
+
+    // --------------------------------------------------------------------------------------------
+    static constexpr size_t
+    align(size_t nbytes) { return (nbytes+alignment-1) & ~(alignment-1); }
+    // rounds nbytes up to the next multiple of alignment
+
+    // --------------------------------------------------------------------------------------------
+    arena(size_t nbytes, bool hugepages = false, bool lock = false) :
+        m_size(align(nbytes))
+    // hugepages and lock are best effort, we silently fall back
+    // to regular pages if the system doesn't allow it
+    // --------------------------------------------------------------------------------------------
+    {
+        if (m_size == 0)
+            m_size = alignment;
+#ifdef _WIN32
+        m_data = static_cast<uint8_t*>(_aligned_malloc(m_size, alignment));
+        (void) hugepages; (void) lock;
+#else
+        m_mapped = m_size;
+    #ifdef MAP_HUGETLB
+        if (hugepages) {
+            // mapping length has to be a multiple of the huge page size
+            constexpr size_t hpsz = 2 << 20;
+            m_mapped = (m_size+hpsz-1) & ~(hpsz-1);
+            auto data = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if (data != MAP_FAILED) {
+                m_data = static_cast<uint8_t*>(data);
+                m_hugepages = true;
+            }
+            else m_mapped = m_size;
+        }
+    #endif
+        if (m_data == nullptr) {
+            auto data = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (data != MAP_FAILED)
+                m_data = static_cast<uint8_t*>(data);
+            else m_mapped = 0;
+    #ifdef MADV_HUGEPAGE
+            if (m_data && hugepages)
+                // transparent huge pages, if enabled
+                madvise(m_data, m_mapped, MADV_HUGEPAGE);
+    #endif
+        }
+
+        if (m_data && lock)
+            m_locked = mlock(m_data, m_mapped) == 0;
+#endif
+        if (m_data == nullptr) {
+            m_size = 0;
+            return;
+        }
+
+        // touch all pages now, so that the audio thread won't fault on them
+        memset(m_data, 0, m_size);
+    }
+
+    // --------------------------------------------------------------------------------------------
+    ~arena()
+    // --------------------------------------------------------------------------------------------
+    {
+        if (m_data == nullptr)
+            return;
+#ifdef _WIN32
+        _aligned_free(m_data);
+#else
+        munmap(m_data, m_mapped);
+#endif
+    }
+
+    // --------------------------------------------------------------------------------------------
+    arena(arena const&) = delete;
+    arena& operator=(arena const&) = delete;
+
+    // --------------------------------------------------------------------------------------------
+    template<typename T> T*
+    at(size_t offset) noexcept { return reinterpret_cast<T*>(m_data+offset); }
+    // returns a pointer to offset, which should be a multiple of alignment
+
+    // --------------------------------------------------------------------------------------------
+    uint8_t*
+    data() noexcept { return m_data; }
+
+    size_t
+    size() const noexcept { return m_size; }
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    hugepages() const noexcept { return m_hugepages; }
+    // returns true if arena is explicitely backed by huge pages
+
+    bool
+    locked() const noexcept { return m_locked; }
+    // returns true if arena is locked in physical memory
+
+private:
+
+    // --------------------------------------------------------------------------------------------
+    uint8_t*
+    m_data = nullptr;
+
+    size_t
+    m_size = 0,
+    m_mapped = 0;
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    m_hugepages = false,
+    m_locked = false;
+};
+
+// ================================================================================================
+template<typename T>
+struct aligned_allocator
+// allocates cache-line aligned storage for std containers, e.g. the plan's cable table
+// ================================================================================================
+{
+    using value_type = T;
+
+    aligned_allocator() noexcept = default;
+
+    template<typename U>
+    aligned_allocator(aligned_allocator<U> const&) noexcept {}
+
+    // --------------------------------------------------------------------------------------------
+    T*
+    allocate(size_t n)
+    {
+        return static_cast<T*>(::operator new(n*sizeof(T), std::align_val_t(arena::alignment)));
+    }
+
+    void
+    deallocate(T* data, size_t) noexcept
+    {
+        ::operator delete(data, std::align_val_t(arena::alignment));
+    }
+
+    // --------------------------------------------------------------------------------------------
+    template<typename U> bool
+    operator==(aligned_allocator<U> const&) const noexcept { return true; }
+
+    template<typename U> bool
+    operator!=(aligned_allocator<U> const&) const noexcept { return false; }
+};
+
+} // end namespace wpn114
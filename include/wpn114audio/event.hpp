@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+using sample_t = float;
+using vector_t = uint16_t;
+
+//-------------------------------------------------------------------------------------------------
+struct event_t
+// a single Trigger/Gate event
+//-------------------------------------------------------------------------------------------------
+{
+    vector_t frame;
+    sample_t value;
+};
+
+//-------------------------------------------------------------------------------------------------
+class eventbuffer
+// a fixed capacity list of events, sorted by frame
+// sparse Ports (Trigger, Gate) only store and mix their events, not the frames in between
+//-------------------------------------------------------------------------------------------------
+{
+
+public:
+    //---------------------------------------------------------------------------------------------
+    eventbuffer() {}
+    eventbuffer(size_t capacity) { allocate(capacity); }
+
+    //---------------------------------------------------------------------------------------------
+    eventbuffer(eventbuffer const&) = delete;
+    eventbuffer& operator=(eventbuffer const&) = delete;
+    // the buffer owns its events
+
+    //---------------------------------------------------------------------------------------------
+    ~eventbuffer() { delete[] m_data; }
+
+    //---------------------------------------------------------------------------------------------
+    void
+    allocate(size_t capacity)
+    //---------------------------------------------------------------------------------------------
+    {
+        m_data = new event_t[capacity]();
+        m_capacity = capacity;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    event_t*
+    begin() { return m_data; }
+
+    event_t*
+    end() { return m_data+m_size; }
+
+    //---------------------------------------------------------------------------------------------
+    size_t
+    count() const { return m_size; }
+
+    //---------------------------------------------------------------------------------------------
+    bool
+    empty() const { return m_size == 0; }
+
+    //---------------------------------------------------------------------------------------------
+    void
+    clear() { m_size = 0; }
+
+    //---------------------------------------------------------------------------------------------
+    bool
+    push(event_t event)
+    // appends event, or inserts it at its frame if an event comes later
+    // events sharing the same frame keep their order
+    //---------------------------------------------------------------------------------------------
+    {
+        if (m_size == m_capacity)
+            return false;
+
+        if (m_size && m_data[m_size-1].frame > event.frame) {
+            auto position = std::upper_bound(begin(), end(), event.frame,
+                            [](vector_t frame, event_t const& e) { return frame < e.frame; });
+            std::move_backward(position, end(), end()+1);
+           *position = event;
+        }
+        else m_data[m_size] = event;
+
+        m_size++;
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    size_t
+    merge(eventbuffer const& source, sample_t mul = 1, sample_t add = 0)
+    // merges source's events into this buffer, scaling their values
+    // both lists are sorted: they're merged in place, starting from the back
+    // the latest source events are dropped if they don't fit, returns the number of merged ones
+    //---------------------------------------------------------------------------------------------
+    {
+        auto nevents = std::min(source.m_size, m_capacity-m_size);
+        size_t d = m_size, s = nevents, n = m_size+nevents;
+
+        while (s > 0)
+        {
+            if (d > 0 && m_data[d-1].frame > source.m_data[s-1].frame)
+                m_data[--n] = m_data[--d];
+            else {
+                auto event = source.m_data[--s];
+                event.value = event.value*mul+add;
+                m_data[--n] = event;
+            }
+        }
+
+        m_size += nevents;
+        return nevents;
+    }
+
+private:
+    //---------------------------------------------------------------------------------------------
+    event_t*
+    m_data = nullptr;
+
+    size_t
+    m_size = 0,
+    m_capacity = 0;
+};
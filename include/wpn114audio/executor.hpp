@@ -0,0 +1,284 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#ifdef __APPLE__
+    #include <dispatch/dispatch.h>
+#else
+    #include <semaphore.h>
+#endif
+
+#include <wpn114audio/graph.hpp>
+
+namespace wpn114
+{
+
+// ================================================================================================
+class semaphore
+// thin wrapper around the platform's counting semaphore
+// post() doesn't lock nor allocate, it is safe to call from the audio thread
+// ================================================================================================
+{
+
+public:
+
+    // --------------------------------------------------------------------------------------------
+    semaphore()
+    // --------------------------------------------------------------------------------------------
+    {
+#ifdef __APPLE__
+        m_sem = dispatch_semaphore_create(0);
+#else
+        sem_init(&m_sem, 0, 0);
+#endif
+    }
+
+    // --------------------------------------------------------------------------------------------
+    ~semaphore()
+    // --------------------------------------------------------------------------------------------
+    {
+#ifdef __APPLE__
+        dispatch_release(m_sem);
+#else
+        sem_destroy(&m_sem);
+#endif
+    }
+
+    // --------------------------------------------------------------------------------------------
+    void
+    post()
+    // --------------------------------------------------------------------------------------------
+    {
+#ifdef __APPLE__
+        dispatch_semaphore_signal(m_sem);
+#else
+        sem_post(&m_sem);
+#endif
+    }
+
+    // --------------------------------------------------------------------------------------------
+    void
+    wait()
+    // --------------------------------------------------------------------------------------------
+    {
+#ifdef __APPLE__
+        dispatch_semaphore_wait(m_sem, DISPATCH_TIME_FOREVER);
+#else
+        while (sem_wait(&m_sem) != 0);
+#endif
+    }
+
+private:
+
+#ifdef __APPLE__
+    dispatch_semaphore_t
+    m_sem;
+#else
+    sem_t
+    m_sem;
+#endif
+};
+
+// ================================================================================================
+class wsdeque
+// fixed-capacity work-stealing deque (Chase-Lev), holding task indices
+// the owner thread pushes and takes at the bottom,
+// other threads steal from the top
+// ================================================================================================
+{
+
+public:
+
+    // --------------------------------------------------------------------------------------------
+    static size_t
+    capacity(size_t ntasks)
+    // deque capacity is rounded up to the closest power of two
+    // --------------------------------------------------------------------------------------------
+    {
+        size_t p2 = 1;
+        while (p2 < ntasks)
+               p2 <<= 1;
+
+        return p2;
+    }
+
+    // --------------------------------------------------------------------------------------------
+    void
+    assign(std::atomic<uint32_t>* data, size_t capacity)
+    // storage is owned by the plan being processed, capacity has to be a power of two
+    // not thread-safe, only called in between two runs
+    // --------------------------------------------------------------------------------------------
+    {
+        m_data = data;
+        m_mask = static_cast<int64_t>(capacity)-1;
+    }
+
+    // --------------------------------------------------------------------------------------------
+    void
+    clear()
+    // not thread-safe, only called in between two runs
+    // --------------------------------------------------------------------------------------------
+    {
+        m_top.store(0, std::memory_order_relaxed);
+        m_bottom.store(0, std::memory_order_relaxed);
+    }
+
+    // --------------------------------------------------------------------------------------------
+    void
+    push(uint32_t index)
+    // owner only
+    // --------------------------------------------------------------------------------------------
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        m_data[b & m_mask].store(index, std::memory_order_relaxed);
+        m_bottom.store(b+1, std::memory_order_release);
+    }
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    take(uint32_t& index)
+    // owner only
+    // --------------------------------------------------------------------------------------------
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed)-1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // empty
+            m_bottom.store(b+1, std::memory_order_relaxed);
+            return false;
+        }
+
+        index = m_data[b & m_mask].load(std::memory_order_relaxed);
+
+        if (t == b) {
+            // last element, race against thieves
+            bool won = m_top.compare_exchange_strong(t, t+1,
+                       std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b+1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    steal(uint32_t& index)
+    // any thread
+    // --------------------------------------------------------------------------------------------
+    {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return false;
+
+        index = m_data[t & m_mask].load(std::memory_order_relaxed);
+        return m_top.compare_exchange_strong(t, t+1,
+               std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+private:
+
+    // --------------------------------------------------------------------------------------------
+    alignas(64) std::atomic<int64_t>
+    m_top {0};
+
+    alignas(64) std::atomic<int64_t>
+    m_bottom {0};
+
+    // --------------------------------------------------------------------------------------------
+    std::atomic<uint32_t>*
+    m_data = nullptr;
+
+    int64_t
+    m_mask = 0;
+};
+
+} // end namespace wpn114
+
+//=================================================================================================
+class Executor
+// a pool of real-time worker threads, processing the Graph's execution plan tasks
+// in parallel, as soon as their dependencies are resolved (see Graph::task).
+// the calling (audio) thread takes part in the processing, and returns
+// only when the whole plan has been processed
+//=================================================================================================
+{
+
+public:
+
+    // --------------------------------------------------------------------------------------------
+    Executor(Graph& graph, size_t nthreads);
+    // nthreads includes the calling audio thread,
+    // nthreads-1 workers will be spawned
+
+    // --------------------------------------------------------------------------------------------
+    ~Executor();
+
+    // --------------------------------------------------------------------------------------------
+    void
+    prepare(Graph::plan& plan);
+    // allocates the plan's per-task counters and deque storage
+    // this has to be called outside of the audio thread, before the plan is published
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD void
+    run(Graph::plan const& plan, vector_t nframes) noexcept;
+    // processes all plan tasks, returns when they're all done
+
+    // --------------------------------------------------------------------------------------------
+    size_t
+    nthreads() const noexcept { return m_deques.size(); }
+
+private:
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD void
+    work(size_t index) noexcept;
+    // processes tasks until there's no more left in the current run
+
+    // --------------------------------------------------------------------------------------------
+    void
+    worker(size_t index);
+    // worker thread main loop
+
+    // --------------------------------------------------------------------------------------------
+    Graph&
+    m_graph;
+
+    // --------------------------------------------------------------------------------------------
+    std::vector<std::thread>
+    m_threads;
+
+    std::vector<wpn114::wsdeque>
+    m_deques;
+
+    wpn114::semaphore
+    m_wakeup;
+
+    // --------------------------------------------------------------------------------------------
+    Graph::plan const*
+    m_plan = nullptr;
+
+    vector_t
+    m_nframes = 0;
+
+    // --------------------------------------------------------------------------------------------
+    alignas(64) std::atomic<uint32_t>
+    m_remaining {0};
+
+    alignas(64) std::atomic<uint32_t>
+    m_busy {0};
+
+    std::atomic<bool>
+    m_exit {false};
+};
@@ -10,8 +10,17 @@
 #include <QJSValue>
 #include <QtDebug>
 #include <cmath>
+#include <list>
+#include <atomic>
+#include <memory>
+#include <bitset>
+#include <unordered_map>
 
 #include <wpn114audio/midi.hpp>
+#include <wpn114audio/event.hpp>
+#include <wpn114audio/ump.hpp>
+#include <wpn114audio/arena.hpp>
+#include <wpn114audio/mix.hpp>
 
 // --------------------------------------------------------------------------------------------------
 // CONVENIENCE MACRO DEFINITIONS
@@ -38,6 +47,31 @@
 #define WPN_DECLARE_MIDI_PORT(_name, _polarity, _nchannels) \
     WPN_PORT(Port::Midi_1_0, _polarity, _name, false, _nchannels)
 
+// ------------------------------------------------------------------------------------------------
+#define WPN_DECLARE_DEFAULT_UMP_PORT(_name, _polarity, _nchannels) \
+    WPN_PORT(Port::Midi_2_0, _polarity, _name, true, _nchannels)
+
+#define WPN_DECLARE_UMP_PORT(_name, _polarity, _nchannels) \
+    WPN_PORT(Port::Midi_2_0, _polarity, _name, false, _nchannels)
+
+// ------------------------------------------------------------------------------------------------
+#define WPN_DECLARE_CONTROL_PORT(_name, _polarity, _nchannels) \
+    WPN_PORT(Port::Control, _polarity, _name, false, _nchannels)
+
+// ------------------------------------------------------------------------------------------------
+#define WPN_DECLARE_DEFAULT_TRIGGER_PORT(_name, _polarity, _nchannels) \
+    WPN_PORT(Port::Trigger, _polarity, _name, true, _nchannels)
+
+#define WPN_DECLARE_TRIGGER_PORT(_name, _polarity, _nchannels) \
+    WPN_PORT(Port::Trigger, _polarity, _name, false, _nchannels)
+
+// ------------------------------------------------------------------------------------------------
+#define WPN_DECLARE_DEFAULT_GATE_PORT(_name, _polarity, _nchannels) \
+    WPN_PORT(Port::Gate, _polarity, _name, true, _nchannels)
+
+#define WPN_DECLARE_GATE_PORT(_name, _polarity, _nchannels) \
+    WPN_PORT(Port::Gate, _polarity, _name, false, _nchannels)
+
 // ------------------------------------------------------------------------------------------------
 #define WPN_DECLARE_DEFAULT_AUDIO_INPUT(_name, _nchannels) \
     WPN_DECLARE_DEFAULT_AUDIO_PORT(_name, Polarity::Input, _nchannels)
@@ -65,6 +99,51 @@
 #define WPN_DECLARE_MIDI_OUTPUT(_name, _nchannels) \
     WPN_DECLARE_MIDI_PORT(_name, Polarity::Output, _nchannels)
 
+#define WPN_DECLARE_CONTROL_INPUT(_name, _nchannels) \
+    WPN_DECLARE_CONTROL_PORT(_name, Polarity::Input, _nchannels)
+
+#define WPN_DECLARE_CONTROL_OUTPUT(_name, _nchannels) \
+    WPN_DECLARE_CONTROL_PORT(_name, Polarity::Output, _nchannels)
+
+// ------------------------------------------------------------------------------------------------
+#define WPN_DECLARE_DEFAULT_TRIGGER_INPUT(_name, _nchannels) \
+    WPN_DECLARE_DEFAULT_TRIGGER_PORT(_name, Polarity::Input, _nchannels)
+
+#define WPN_DECLARE_DEFAULT_TRIGGER_OUTPUT(_name, _nchannels) \
+    WPN_DECLARE_DEFAULT_TRIGGER_PORT(_name, Polarity::Output, _nchannels)
+
+#define WPN_DECLARE_TRIGGER_INPUT(_name, _nchannels) \
+    WPN_DECLARE_TRIGGER_PORT(_name, Polarity::Input, _nchannels)
+
+#define WPN_DECLARE_TRIGGER_OUTPUT(_name, _nchannels) \
+    WPN_DECLARE_TRIGGER_PORT(_name, Polarity::Output, _nchannels)
+
+// ------------------------------------------------------------------------------------------------
+#define WPN_DECLARE_DEFAULT_GATE_INPUT(_name, _nchannels) \
+    WPN_DECLARE_DEFAULT_GATE_PORT(_name, Polarity::Input, _nchannels)
+
+#define WPN_DECLARE_DEFAULT_GATE_OUTPUT(_name, _nchannels) \
+    WPN_DECLARE_DEFAULT_GATE_PORT(_name, Polarity::Output, _nchannels)
+
+#define WPN_DECLARE_GATE_INPUT(_name, _nchannels) \
+    WPN_DECLARE_GATE_PORT(_name, Polarity::Input, _nchannels)
+
+#define WPN_DECLARE_GATE_OUTPUT(_name, _nchannels) \
+    WPN_DECLARE_GATE_PORT(_name, Polarity::Output, _nchannels)
+
+// ------------------------------------------------------------------------------------------------
+#define WPN_DECLARE_DEFAULT_UMP_INPUT(_name, _nchannels) \
+    WPN_DECLARE_DEFAULT_UMP_PORT(_name, Polarity::Input, _nchannels)
+
+#define WPN_DECLARE_DEFAULT_UMP_OUTPUT(_name, _nchannels) \
+    WPN_DECLARE_DEFAULT_UMP_PORT(_name, Polarity::Output, _nchannels)
+
+#define WPN_DECLARE_UMP_INPUT(_name, _nchannels) \
+    WPN_DECLARE_UMP_PORT(_name, Polarity::Input, _nchannels)
+
+#define WPN_DECLARE_UMP_OUTPUT(_name, _nchannels) \
+    WPN_DECLARE_UMP_PORT(_name, Polarity::Output, _nchannels)
+
 // ------------------------------------------------------------------------------------------------
 #define wpnwrap(_v, _limit) if (_v >= _limit) _v -= _limit
 #define CSTR(_qstring) _qstring.toStdString().c_str()
@@ -106,8 +185,25 @@ using byte_t        = uint8_t;
 using vector_t      = uint16_t;
 using nframes_t     = uint32_t;
 
-using audiobuffer_t = sample_t**;
-using midibuffer_t  = midibuffer**;
+//=================================================================================================
+struct control_t
+// a control-rate channel: its value at the block's first frame, and its per-frame ramp
+//=================================================================================================
+{
+    sample_t
+    value = 0,
+    ramp = 0;
+
+    sample_t
+    at(vector_t frame) const noexcept { return value+ramp*frame; }
+    // returns the value at frame
+};
+
+using audiobuffer_t     = sample_t**;
+using midibuffer_t      = midibuffer**;
+using controlbuffer_t   = control_t*;
+using eventbuffer_t     = eventbuffer**;
+using umpbuffer_t       = umpbuffer**;
 
 //=================================================================================================
 struct pool
@@ -116,6 +212,9 @@ struct pool
 {
     std::vector<audiobuffer_t> audio;
     std::vector<midibuffer_t> midi;
+    std::vector<controlbuffer_t> control;
+    std::vector<eventbuffer_t> events;
+    std::vector<umpbuffer_t> ump;
 };
 
 class Connection;
@@ -153,11 +252,27 @@ public:
     enum Values
     {
         Upwards         = 0,
+        // subnodes' outputs are mixed into their parent
+
         Chain           = 1,
+        // parent feeds the first subnode, each subnode feeds the next one
+
         Parallel        = 2,
+        // same as Upwards, subnodes are independent from each other: their outputs are summed
+        // pairwise by parallel tasks, the parent only mixes the final sum (see Graph::reduce)
+
         Split           = 3,
+        // each subnode reads the next channels of this Node's default output, as many as
+        // its default input has (at least one), in place: no sample is copied (see Graph::allocate)
+
         Merge           = 4,
+        // subnodes' default outputs are concatenated into this Node's default input, in place
+
         Expand          = 5
+        // same as Upwards, Node only processes a single channel: it is processed once for each
+        // channel of its widest Audio/Control input, as many lanes (see Node::expand)
+        // lanes share the same Node instance, only Nodes setting m_expandable are expanded,
+        // the others are processed as Upwards
     };
 
     Q_ENUM (Values)
@@ -225,6 +340,10 @@ public:
     null() const { return m_routing.empty(); }
     // returns true if Routing is not explicitely defined
 
+    // --------------------------------------------------------------------------------------------
+    std::vector<cable> const&
+    cables() const { return m_routing; }
+
     // --------------------------------------------------------------------------------------------
     operator
     QVariantList() const
@@ -295,6 +414,7 @@ class Connection : public QObject, public QQmlParserStatus, public QQmlPropertyV
     // --------------------------------------------------------------------------------------------
     friend class Port;
     friend class Node;
+    friend class Graph;
 
 public:
 
@@ -362,26 +482,30 @@ public:
 
     // --------------------------------------------------------------------------------------------
     Q_INVOKABLE void
-    activate() noexcept { m_active = true; }
+    activate() noexcept { set_active(true); }
 
     Q_INVOKABLE void
-    deactivate() noexcept { m_active = false; }
+    deactivate() noexcept { set_active(false); }
 
     void
-    set_active(bool active) noexcept { m_active = active; }
+    set_active(bool active) noexcept;
+    // (de)activating a Connection changes the Graph topology
+    // and therefore triggers a recompilation of its execution plan
 
     bool
     active() const noexcept { return m_active; }
 
     // --------------------------------------------------------------------------------------------
     Q_INVOKABLE void
-    mute() noexcept {  m_muted = true; }
+    mute() noexcept { set_muted(true); }
 
     Q_INVOKABLE void
-    unmute() noexcept { m_muted = false; }
+    unmute() noexcept { set_muted(false); }
 
     void
-    set_muted(bool muted) noexcept { m_muted = muted; }
+    set_muted(bool muted) noexcept;
+    // note: identity Connections may be aliased (see Graph::allocate)
+    // muting them takes effect when the next plan is published
 
     bool
     muted() const noexcept { return m_muted; }
@@ -401,26 +525,30 @@ public:
     // returns Connection's routing matrix as QML formatted list
 
     void
-    set_routing(QVariantList list) noexcept { m_routing = Routing(list); }
+    set_routing(QVariantList list) noexcept { set_routing(Routing(list)); }
     // sets routing matrix from QML
 
     void
-    set_routing(Routing matrix) noexcept { m_routing = matrix; }
+    set_routing(Routing matrix) noexcept;
     // sets routing matrix from C++
+    // the audio thread never reads it directly: it is compiled into
+    // the next execution plan's cable table (see Graph::plan)
 
     // --------------------------------------------------------------------------------------------
     sample_t
     mul() const noexcept { return m_mul; }
 
     void
-    set_mul(sample_t mul) noexcept { m_mul = mul; }
+    set_mul(sample_t mul) noexcept;
 
     // --------------------------------------------------------------------------------------------
     sample_t
     add() const noexcept { return m_add; }
 
     void
-    set_add(sample_t add) noexcept { m_add = add; }
+    set_add(sample_t add) noexcept;
+    // note: the mixing kernel is specialized for the current mul/add values
+    // when they move away from unity gain/zero add, a new plan is requested
 
     // --------------------------------------------------------------------------------------------
     Q_INVOKABLE qreal
@@ -435,8 +563,18 @@ private:
 
     // --------------------------------------------------------------------------------------------
     WPN_AUDIOTHREAD void
-    pull(vector_t nframes) noexcept;
-    // the main processing function
+    pull(vector_t nframes, Routing::cable const* cables, nchannels_t ncables,
+         wpn114::mix::variant variant = wpn114::mix::Affine,
+         wpn114::mix::kernel kernel = nullptr,
+         audiobuffer_t source = nullptr, bool reduced = false) noexcept;
+    // the main processing function, mixes source buffer into dest buffer
+    // along the cables compiled in the current plan (see Graph::plan)
+    // source Node is expected to have already been processed
+    // during the current run
+    // in pipelined plans, source buffers may be read from an earlier run instead
+    // (source silence isn't known then, all cables are mixed)
+    // Control Ports are mixed in O(1) per cable, Audio sources are decimated into them,
+    // and they are interpolated into Audio dests
 
     // --------------------------------------------------------------------------------------------
     std::atomic<bool>
@@ -521,7 +659,7 @@ public:
         // shows what values a specific Port is expecting to receive
         // or is explicitely outputing
         // a connection between a Midi Port and any other Port
-        // that isn't Midi will be refused
+        // that isn't Midi will be refused, same for Midi 2.0 and sparse (Trigger, Gate) Ports
         // otherwise, if connection types mismatch, a warning will be emitted
 
         Audio,
@@ -530,6 +668,22 @@ public:
         Midi_1_0,
         // status byte + 2 other index/value bytes
 
+        Control,
+        // a value and a ramp per channel and per block (see control_t)
+        // Connections between Control Ports are mixed in O(1) per block,
+        // Audio sources are decimated, Audio destinations are interpolated
+
+        Trigger,
+        // single pulses, stored as a sorted list of (frame, value) events (see eventbuffer)
+
+        Gate,
+        // a latched value, only its changes are stored, as Trigger events
+        // Trigger and Gate Ports can be connected together, their Connections merge event lists
+
+        Midi_2_0,
+        // Universal MIDI Packets, 32 or 64-bit words stored as a structure of arrays
+        // (see umpbuffer), converted to and from Midi_1_0 events with umpbuffer::read/write
+
 //        Integer,
 //        // a control integer value
 
@@ -538,12 +692,6 @@ public:
 
 //        Cv,
 //        // -5.0 to 5.0 control voltage values
-
-//        Gate,
-//        // a 0-1 latched value
-
-//        Trigger
-//        // a single pulse (1.f)
     };
 
     Q_ENUM (Type)
@@ -560,11 +708,13 @@ public:
         // this is only called because of the macro Port definitions
         // it shouldn't be called otherwise in any other context
     // --------------------------------------------------------------------------------------------
-        m_polarity  (cp.m_polarity)
+        m_name      (cp.m_name)
+      , m_polarity  (cp.m_polarity)
+      , m_type      (cp.m_type)
       , m_index     (cp.m_index)
       , m_nchannels (cp.m_nchannels)
-      , m_type      (cp.m_type)
-      , m_name      (cp.m_name)
+      , m_inferred  (cp.m_inferred)
+      , m_expand    (cp.m_expand)
       , m_parent    (cp.m_parent)
       , m_default   (cp.m_default) {}
 
@@ -577,6 +727,8 @@ public:
         m_polarity   = cp.m_polarity;
         m_index      = cp.m_index;
         m_nchannels  = cp.m_nchannels;
+        m_inferred   = cp.m_inferred;
+        m_expand     = cp.m_expand;
         m_parent     = cp.m_parent;
         m_type       = cp.m_type;
         m_name       = cp.m_name;
@@ -587,19 +739,22 @@ public:
 
     // --------------------------------------------------------------------------------------------
     ~Port()
+    // Audio buffers are owned by the Graph's arena
     // --------------------------------------------------------------------------------------------
     {
-        if (m_type == Port::Audio) {
-            for (nchannels_t n = 0; n < m_nchannels; ++n)
-                if (m_buffer.audio[n])
-                    delete[] m_buffer.audio[n];
-            delete[] m_buffer.audio;
-        } else {
-            for (nchannels_t n = 0; n < m_nchannels; ++n)
-                if (m_buffer.midi[n])
-                    m_buffer.midi[n]->~midibuffer();
+        if (m_type == Port::Midi_1_0)
             delete[] m_buffer.midi;
-        }
+
+        if (m_type == Port::Control)
+            delete[] m_buffer.control;
+
+        if (sparse())
+            delete[] m_buffer.events;
+
+        if (m_type == Port::Midi_2_0)
+            delete[] m_buffer.ump;
+
+        delete m_schedule.load();
     }
 
     // --------------------------------------------------------------------------------------------
@@ -620,26 +775,122 @@ public:
 
     // --------------------------------------------------------------------------------------------
     WPN_AUDIOTHREAD void
-    pull_value(vector_t nframes) noexcept
+    pull_value(vector_t nframes, nchannels_t nchannels) noexcept
+    // fills the buffer with Port value, before Connections are mixed into it
     // --------------------------------------------------------------------------------------------
     {
-        sample_t v = m_value;
+        sample_t v = current();
+        m_scalar = v;
+        m_constant = m_latched = m_aliased = false;
+        v == 0 ? m_silent.set() : m_silent.reset();
 
-        for (nchannels_t c = 0; c < m_nchannels; ++c)
+        for (nchannels_t c = 0; c < nchannels; ++c)
             for (vector_t f = 0; f < nframes; ++f)
                  m_buffer.audio[c][f] = v;
     }
 
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD void
+    pull_control(nchannels_t nchannels) noexcept
+    // sets all channels to Port value, without any ramp, before Connections are mixed into them
+    // --------------------------------------------------------------------------------------------
+    {
+        sample_t v = current();
+        m_scalar = v;
+        m_bound_nchannels = nchannels;
+
+        for (nchannels_t c = 0; c < nchannels; ++c)
+             m_buffer.control[c] = { v, 0 };
+    }
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD void
+    latch(vector_t nframes, nchannels_t nchannels) noexcept
+    // latches Port value for the current run, Port has no active Connection
+    // the buffer is only filled if its value has changed, and if the parent Node
+    // hasn't declared it would take care of it (see set_lazy)
+    // --------------------------------------------------------------------------------------------
+    {
+        m_scalar = current();
+        m_constant = true;
+        m_aliased = false;
+        m_scalar == 0 ? m_silent.set() : m_silent.reset();
+
+        if (!m_lazy)
+            materialize(nframes, nchannels);
+    }
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD audiobuffer_t
+    materialize(vector_t nframes, nchannels_t nchannels) noexcept
+    // fills a block-constant Port's buffer with its scalar value, if not already done
+    // --------------------------------------------------------------------------------------------
+    {
+        if (!m_latched || m_latched_value != m_scalar)
+        {
+            for (nchannels_t c = 0; c < nchannels; ++c)
+                for (vector_t f = 0; f < nframes; ++f)
+                     m_buffer.audio[c][f] = m_scalar;
+
+            m_latched = true;
+            m_latched_value = m_scalar;
+        }
+
+        return m_buffer.audio;
+    }
+
+    WPN_AUDIOTHREAD audiobuffer_t
+    materialize(vector_t nframes) noexcept { return materialize(nframes, m_bound_nchannels); }
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD bool
+    constant() const noexcept { return m_constant; }
+    // returns true if Port holds the same value on all channels and frames for the current run
+    // (Audio input Port, without any active Connection)
+
+    WPN_AUDIOTHREAD sample_t
+    scalar() const noexcept { return m_scalar; }
+    // returns block-constant Port value for the current run
+    // or for the current segment, if its Node's block is split (see Graph::accurate)
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD bool
+    silent(nchannels_t channel) const noexcept { return m_silent.test(channel); }
+    // returns true if Audio Port channel only holds zeros for the current run
+    // output Ports are checked after their Node has been processed, unless flagged by the Node
+    // silence then propagates through Connections: silent channels are not mixed
+
+    WPN_AUDIOTHREAD bool
+    silent() const noexcept;
+    // returns true if all Port channels are silent (Audio, Control), or hold no event (Midi...)
+
+    WPN_AUDIOTHREAD void
+    set_silent(nchannels_t channel, bool silent = true) noexcept { m_silent.set(channel, silent); }
+    // may be called by a Node from its rwrite function, on its output Ports,
+    // the channel buffer has then to be filled with zeros
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    lazy() const noexcept { return m_lazy; }
+
+    void
+    set_lazy(bool lazy) { m_lazy = lazy; }
+    // set by Nodes taking scalar fast paths on this Port when it is block-constant:
+    // its buffer is then left as is, and has to be requested with materialize()
+    // before being read
+
     // --------------------------------------------------------------------------------------------
     void
-    set_value(qreal value)
+    set_value(qreal value);
     // an asynchronous write (from the Qt/GUI main thread)
     // with an explicit latched value
     // note: it might be good to use qvariant instead, for lists
-    {
-        m_value = value;
-    }
 
+    Q_INVOKABLE void
+    set_value(qreal value, quint64 time);
+    // schedules a value change at Graph clock frame time (see Graph::clock), Audio/Control inputs
+    // values have to be scheduled in chronological order: they are applied at the exact frame
+    // by Nodes processing segments (see Graph::accurate), at the start of its block otherwise
 
     // --------------------------------------------------------------------------------------------
     bool
@@ -665,13 +916,26 @@ public:
 
     // --------------------------------------------------------------------------------------------
     nchannels_t
-    nchannels() const noexcept { return m_nchannels; }
-    // returns Port number of channels
+    nchannels() const noexcept { return m_expand ? m_inferred : m_nchannels; }
+    // returns Port number of channels, inferred from the graph if it hasn't been set
+
+    nchannels_t
+    capacity() const noexcept { return m_capacity; }
+    // returns the number of channels Port's buffer has been allocated for
+
+    WPN_AUDIOTHREAD nchannels_t
+    bound_nchannels() const noexcept { return m_bound_nchannels; }
+    // returns the number of channels of the buffers bound for the current run
+
+    std::vector<std::shared_ptr<midibuffer>> const&
+    midibuffers() const noexcept { return m_midi; }
+    // returns a Midi_1_0 Port's own buffers, shared ones included (see Port::share)
 
     void
     set_nchannels(nchannels_t nchannels);
     // sets num_channels for Port and
     // allocate/reallocate its buffer
+    // Ports declared with 0 channels aren't expanded anymore (see Graph::expand)
 
     // --------------------------------------------------------------------------------------------
     Polarity
@@ -682,6 +946,10 @@ public:
     Type
     type() const noexcept { return m_type; }
 
+    bool
+    sparse() const noexcept { return m_type == Port::Trigger || m_type == Port::Gate; }
+    // returns true if Port holds events instead of frames (Trigger, Gate)
+
     // --------------------------------------------------------------------------------------------
     QString
     name() const noexcept { return m_name; }
@@ -701,6 +969,28 @@ public:
     template<typename T> void
     set_buffer(T& buffer) noexcept;
 
+    // --------------------------------------------------------------------------------------------
+    bool
+    persistent() const noexcept { return m_persistent; }
+
+    void
+    set_persistent(bool persistent) { m_persistent = persistent; }
+    // a persistent Port always gets a buffer of its own, never shared with other Ports
+    // this is required when it is accessed outside of the Graph's execution plan
+    // (i/o backends, other Nodes...) or when its content has to be kept in between two runs
+
+    // --------------------------------------------------------------------------------------------
+    void
+    link(Port& target, QVector<nchannels_t> const& channels);
+    // makes this Port's channels alias target's channels (Audio only)
+    // channel n of this Port will share the buffer of target's channel channels[n]
+
+    // --------------------------------------------------------------------------------------------
+    void
+    share(Port& target, QVector<nchannels_t> const& channels);
+    // same for Midi_1_0 Ports, which own their buffers: channel n of this Port will share
+    // target's channel channels[n] midibuffer, and the ones plans bring (see Graph::allocate)
+
     // --------------------------------------------------------------------------------------------
     std::vector<Connection*>&
     connections() noexcept { return m_connections; }
@@ -732,6 +1022,8 @@ private:
     // --------------------------------------------------------------------------------------------
     void
     allocate(vector_t nframes);
+    // allocates Midi (1.0, 2.0), Control and event buffers, Audio buffers are laid out
+    // in Graph's arena, each time a plan is compiled (see Graph::allocate)
 
     // --------------------------------------------------------------------------------------------
     void
@@ -739,13 +1031,43 @@ private:
     // note: this one is actually never called at the moment
     // --------------------------------------------------------------------------------------------
     {
-        for (nchannels_t n = 0; n < m_nchannels; ++n)
+        for (nchannels_t n = 0; n < m_bound_nchannels; ++n)
              memset(m_buffer.audio[n], 0, sizeof(sample_t*)*nframes);
     }
 
     // --------------------------------------------------------------------------------------------
-    void
-    reset();
+    WPN_AUDIOTHREAD sample_t
+    current() noexcept
+    // the value Port is filled with: its last scheduled value (see dequeue), until
+    // a new value is set from the Qt/GUI thread, the value property is left untouched
+    // --------------------------------------------------------------------------------------------
+    {
+        auto writes = m_writes.load(std::memory_order_acquire);
+
+        if (writes != m_seen) {
+            m_seen = writes;
+            m_current = m_value.load(std::memory_order_relaxed);
+        }
+
+        return m_current;
+    }
+
+    WPN_AUDIOTHREAD bool
+    dequeue(uint64_t time) noexcept;
+    // sets Port's current value to the last scheduled value due before time,
+    // returns false if there's none
+
+    WPN_AUDIOTHREAD void
+    apply(uint64_t time, vector_t frame, vector_t nframes) noexcept;
+    // applies the values due at time, from frame to the end of the block (see Graph::split)
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD void
+    reset() noexcept { clear(m_bound_nchannels); }
+
+    WPN_AUDIOTHREAD void
+    clear(nchannels_t nchannels) noexcept;
+    // clears the first nchannels Midi (1.0, 2.0) or event buffers
 
     // --------------------------------------------------------------------------------------------
     WPN_INCOMPLETE void
@@ -779,7 +1101,15 @@ private:
 
     // --------------------------------------------------------------------------------------------
     uint8_t
-    m_nchannels = 0;
+    m_nchannels = 0,
+    m_inferred = 0,
+    m_capacity = 0;
+
+    bool
+    m_expand = false;
+    // Port has been declared without any channel, and its number of channels
+    // hasn't been set explicitly: it is inferred from the graph (see Graph::expand),
+    // into m_inferred, the declared one is left as is
 
     // --------------------------------------------------------------------------------------------
     std::vector<Connection*>
@@ -789,11 +1119,18 @@ private:
     Node*
     m_parent = nullptr;
 
+    // --------------------------------------------------------------------------------------------
+    Port*
+    m_link = nullptr;
+
+    QVector<nchannels_t>
+    m_link_channels;
+
     // --------------------------------------------------------------------------------------------    
     union buffer
     // --------------------------------------------------------------------------------------------
     {
-        buffer() {}
+        buffer() : audio(nullptr) {}
         ~buffer() {}
 
         audiobuffer_t
@@ -802,12 +1139,38 @@ private:
         midibuffer_t
         midi;
 
+        controlbuffer_t
+        control;
+
+        eventbuffer_t
+        events;
+
+        umpbuffer_t
+        ump;
+
     }   m_buffer;
 
+    std::vector<std::shared_ptr<eventbuffer>>
+    m_events;
+    // a sparse Port's own buffers, holding m_nframes events, its channel table (m_buffer)
+    // points to them, or to the buffers of plans with larger blocks (see Graph::bind)
+
+    std::vector<std::shared_ptr<umpbuffer>>
+    m_packets;
+    // same for Midi_2_0 Ports, their buffers are sized for m_nframes (see Port::allocate)
+
+    std::vector<std::shared_ptr<midibuffer>>
+    m_midi;
+    // same for Midi_1_0 Ports, some of them may be shared with another Port (see Port::share)
+
+    vector_t
+    m_nframes = 0;
+
     // --------------------------------------------------------------------------------------------
     bool
     m_muted = false,
-    m_default = false;
+    m_default = false,
+    m_persistent = false;
 
     // --------------------------------------------------------------------------------------------
     qreal
@@ -818,6 +1181,60 @@ private:
     std::atomic<qreal>
     m_value;
 
+    std::atomic<uint32_t>
+    m_writes {0};
+    // number of values set from the Qt/GUI thread, see current()
+
+    // --------------------------------------------------------------------------------------------
+    struct schedule
+    // scheduled values, single producer (Qt/GUI thread), single consumer (audio thread)
+    // --------------------------------------------------------------------------------------------
+    {
+        static constexpr size_t
+        capacity = 64;
+
+        std::array<std::pair<uint64_t, qreal>, capacity>
+        events;
+
+        std::atomic<size_t>
+        head {0}, tail {0};
+    };
+
+    std::atomic<schedule*>
+    m_schedule {nullptr};
+    // allocated with the first scheduled value
+
+    // --------------------------------------------------------------------------------------------
+    sample_t
+    m_scalar = 0,
+    m_latched_value = 0,
+    m_current = 0;
+    // audio thread side: value the Port has been latched (block-constant) or filled with,
+    // the one the buffer was last filled with, and its last set or scheduled value
+
+    uint32_t
+    m_seen = 0;
+    // audio thread side: last m_writes picked up
+
+    bool
+    m_constant = false,
+    m_latched = false,
+    m_aliased = false,
+    m_lazy = false;
+
+    std::bitset<256>
+    m_silent;
+    // audio thread side: silent channels for the current run (see Port::silent)
+
+    nchannels_t
+    m_bound_nchannels = 0;
+    // audio thread side: number of channels of the buffers the running plan has bound,
+    // m_nchannels and m_capacity may already have been changed for the next one
+
+    audiobuffer_t
+    m_own = nullptr;
+    // audio thread side: an aliased Port's own channel buffers (see Graph::binding)
+
     // --------------------------------------------------------------------------------------------
     Routing
     m_routing;
@@ -826,6 +1243,7 @@ private:
 Q_DECLARE_METATYPE(Port)
 
 class External;
+class Executor;
 
 //=================================================================================================
 class Graph : public QObject, public QQmlParserStatus
@@ -844,6 +1262,55 @@ class Graph : public QObject, public QQmlParserStatus
     // --------------------------------------------------------------------------------------------
     Q_PROPERTY (qreal rate READ rate WRITE set_rate)
 
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (int threads READ threads WRITE set_threads)
+    // number of threads processing the Graph (including the audio thread)
+    // 1 (default) processes the Graph serially,
+    // otherwise, independent branches are processed concurrently
+    // output remains identical in both cases
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (int stages READ stages WRITE set_stages)
+    // number of pipeline stages (default: 1, no pipelining)
+    // the plan is cut into consecutive stages, each of them processing a different block
+    // on one of the Graph's threads: throughput of long serial chains scales with the number
+    // of stages, at the cost of stages-1 blocks of latency (see Graph::pipeline)
+    // it can't exceed the number of threads
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (int block READ block WRITE set_block)
+    // size of the blocks processed by the Graph, in frames
+    // 0 (default): follows the period of the i/o backend
+    // otherwise, the backend's periods are cut into (or accumulated up to) blocks
+    // if the period isn't a multiple of block, i/o goes through FIFOs,
+    // adding a block of latency (see External::process)
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (int latency READ latency NOTIFY latencyChanged)
+    // latency added by the pipeline stages and i/o FIFOs, in frames (read-only)
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (bool hugepages READ hugepages WRITE set_hugepages)
+    // backs the audio buffer arena with huge pages, if the system allows it (default: false)
+    // this applies from the next time the arena is allocated
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (bool mlock READ mlock WRITE set_mlock)
+    // locks the audio buffer arena in physical memory, if the system allows it (default: false)
+    // this applies from the next time the arena is allocated
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (bool suspend READ suspend WRITE set_suspend)
+    // removes Nodes that can only reach sinks through muted or inactive Connections
+    // from the execution plan (default: false), once their tail has been processed
+    // (see Node::tail), they are processed again as soon as one of these is unmuted
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY (bool accurate READ accurate WRITE set_accurate)
+    // sample-accurate processing (default: false): the blocks of Nodes processing segments
+    // (see Node::rwrite) are split at their inputs' Midi/Trigger/Gate events and scheduled values,
+    // otherwise, these Nodes process whole blocks, and scheduled values apply at block start
+
     // --------------------------------------------------------------------------------------------
     Q_PROPERTY (QQmlListProperty<Node> subnodes READ subnodes)
     // this is the default list property
@@ -868,6 +1335,285 @@ public:
         vector = 512;
     };
 
+    // --------------------------------------------------------------------------------------------
+    struct operation
+    // a single step of the compiled execution plan
+    // --------------------------------------------------------------------------------------------
+    {
+        enum Type : uint8_t
+        {
+            Fill        = 0,
+            // latches Port value into its buffer (Audio, Control), or clears it (Midi, events)
+
+            Mix         = 1,
+            // mixes Connection source buffer into its dest buffer
+
+            Process     = 2,
+            // calls Node's rwrite function
+
+            Clear       = 3,
+            // clears an Audio output Port buffer, shared with other Ports (see Graph::allocate)
+
+            Alias       = 4,
+            // replaces the Mix operations of an Audio input Port reading its
+            // Connections' source buffers in place (see Graph::allocate)
+            // nothing is mixed, it orders Connection's source and dest Nodes,
+            // and forwards the silence of the source channels to dest
+
+            Latch       = 5,
+            // latches the value of an Audio input Port without any active Connection
+            // (see Port::latch)
+
+            Reduce      = 6,
+            // accumulates Connection's source buffer into target, the source buffer of
+            // a sibling Connection to the same dest (see Dispatch::Parallel)
+
+            Fuse        = 7,
+            // processes the next operations (a chain of Nodes and their Connections)
+            // tile by tile, instead of block by block (see Graph::fuse)
+
+            Transform   = 8
+            // processes the next operations (a chain of Midi filters) event by event,
+            // in a single pass (see Graph::transform)
+        };
+
+        Type
+        type;
+
+        union {
+            Port* port;
+            Connection* connection;
+            Node* node;
+        };
+
+        nchannels_t
+        nchannels = 0;
+        // number of channels to fill (or cables to mix), as of compilation time
+        // Ports and Connections may change theirs while the plan is running
+
+        Routing::cable const*
+        cables = nullptr;
+        // Connection's compiled routing, in plan's cable table
+
+        Port*
+        target = nullptr;
+        // Reduce: the output Port Connection's source is accumulated into
+
+        Connection*
+        scale = nullptr;
+        // Reduce: target's own Connection, if this is the first reduction into target,
+        // its gain (and mute) is applied to target before source is accumulated
+
+        bool
+        reduced = false;
+        // Mix: source holds a reduction (see Graph::reduce), the gains of all the summed
+        // Connections have already been applied, Connection's own gain is left out
+
+        uint32_t
+        length = 0;
+        // Fuse, Transform: number of operations processed by this one, following it
+
+        wpn114::mix::variant
+        variant = wpn114::mix::Affine;
+
+        wpn114::mix::kernel
+        kernel = nullptr;
+        // Audio mixing kernel, selected for Connection's mul/add values
+        // and the instruction set of the CPU we're running on
+
+        uint8_t
+        delay = 0;
+
+        uint32_t
+        ring = 0;
+        // pipelined plans: number of runs separating Connection's source and dest stages,
+        // source buffers are then read from its ring (see Graph::pipeline)
+    };
+
+    // --------------------------------------------------------------------------------------------
+    struct task
+    // the operations processing a single Node (or a fused chain, see Graph::fuse),
+    // and its dependencies
+    // used to schedule the plan on multiple threads (see Executor)
+    // --------------------------------------------------------------------------------------------
+    {
+        uint32_t
+        begin = 0,
+        end = 0;
+        // range of operations in plan
+
+        uint32_t
+        sbegin = 0,
+        send = 0;
+        // range of successor task indexes in plan
+
+        uint32_t
+        ndependencies = 0;
+    };
+
+    // --------------------------------------------------------------------------------------------
+    struct binding
+    // the location of an Audio Port's channel table within the arena
+    // --------------------------------------------------------------------------------------------
+    {
+        Port*
+        port = nullptr;
+
+        audiobuffer_t
+        table = nullptr;
+
+        audiobuffer_t*
+        slot = nullptr;
+        // the parent Node's pool entry for this Port
+
+        bool
+        alias = false;
+        // input Port reads its Connections' source channels in place,
+        // channel n reads plan's view + n (see Graph::allocate)
+
+        uint32_t
+        view = 0;
+
+        audiobuffer_t
+        own = nullptr;
+        // aliased Ports: their own channel buffers, bound instead of the view's ones
+        // whenever Port's value isn't zero (see Graph::run)
+
+        nchannels_t
+        nchannels = 0;
+    };
+
+    // --------------------------------------------------------------------------------------------
+    struct route
+    // the range of a Connection's cables in plan's cable table
+    // --------------------------------------------------------------------------------------------
+    {
+        uint32_t
+        begin = 0;
+
+        nchannels_t
+        ncables = 0;
+    };
+
+    // --------------------------------------------------------------------------------------------
+    struct ring
+    // pipelined plans: the buffers of an Audio output Port read by later stages,
+    // one channel table per run in flight, rotated at the end of each run
+    // --------------------------------------------------------------------------------------------
+    {
+        Port*
+        port = nullptr;
+
+        audiobuffer_t*
+        slot = nullptr;
+
+        uint32_t
+        begin = 0;
+        // range of channel tables in plan's ring tables, starting with Port's binding table
+
+        nchannels_t
+        nchannels = 0;
+
+        uint8_t
+        depth = 0;
+    };
+
+    // --------------------------------------------------------------------------------------------
+    struct plan
+    // a flat, topologically sorted array of operations
+    // compiled when Graph is complete, and each time its topology changes
+    // the audio thread only has to iterate over it, without any recursion
+    // once published, a plan is immutable: it is an execution snapshot
+    // that will be swapped with the next one in between two runs
+    // --------------------------------------------------------------------------------------------
+    {
+        std::vector<operation>
+        operations;
+
+        std::vector<task>
+        tasks;
+
+        std::vector<uint32_t>
+        successors;
+
+        std::vector<operation>
+        midi_outputs;
+        // clears Midi (1.0, 2.0) and sparse output Ports at the end of each run
+
+        std::vector<Routing::cable, wpn114::aligned_allocator<Routing::cable>>
+        cables;
+        // all active Connections' routings, as source/dest channel pairs
+        // implicit routings are expanded, and out-of-range cables dropped
+        // it is filled before the operations, and never resized afterwards
+
+        std::unordered_map<Connection const*, route>
+        routes;
+
+        size_t
+        nnodes = 0,
+        nedges = 0;
+
+        uint64_t
+        epoch = 0;
+        // incremented each time a new plan is published
+
+        std::unique_ptr<std::atomic<uint32_t>[]>
+        pending,
+        queues;
+
+        size_t
+        queue_capacity = 0;
+        // Executor runtime storage (see Executor::prepare)
+
+        std::shared_ptr<wpn114::arena>
+        arena;
+        // audio buffers, shared with the previous plan if their layout hasn't changed
+
+        std::vector<binding>
+        bindings;
+
+        std::vector<std::pair<Port*, nchannels_t>>
+        views;
+        // the source Port and channel of each channel of aliased input Ports
+
+        std::vector<uint32_t>
+        buffers;
+        // arena channel buffer assigned to each binding channel
+
+        std::vector<std::pair<eventbuffer**, std::shared_ptr<eventbuffer>>>
+        events;
+        // the buffer each sparse Port channel table entry points to while plan is run,
+        // holding one event per frame of plan's block
+
+        std::vector<std::pair<umpbuffer**, std::shared_ptr<umpbuffer>>>
+        packets;
+        // same for Midi_2_0 Ports
+
+        std::vector<std::pair<midibuffer**, std::shared_ptr<midibuffer>>>
+        midi;
+        // same for Midi_1_0 Ports, shared channels (see Port::share) get the same buffer
+
+        std::vector<uint32_t>
+        stages;
+        // pipeline stage of each task, empty if plan isn't pipelined
+
+        size_t
+        nstages = 1;
+
+        std::vector<ring>
+        rings;
+
+        std::vector<audiobuffer_t>
+        ring_tables;
+
+        vector_t
+        nframes = 0;
+
+        bool
+        accurate = false;
+        // Nodes processing segments have their blocks split (see Graph::split)
+    };
+
     // --------------------------------------------------------------------------------------------
     Graph();
 
@@ -877,8 +1623,7 @@ public:
     // returns the singleton instance of the Graph
 
     // --------------------------------------------------------------------------------------------
-    virtual ~Graph() override {}
-    // there might be something to be done later on
+    virtual ~Graph() override;
 
     // --------------------------------------------------------------------------------------------
     virtual void
@@ -932,9 +1677,8 @@ public:
         if (auto con = get_connection(source, dest)) {
             source.remove_connection(*con);
             dest.remove_connection(*con);
-
-            m_connections.erase(std::remove(m_connections.begin(),
-                m_connections.end(), *con), m_connections.end());
+            retire(*con);
+            update();
         }
     }
 
@@ -956,7 +1700,7 @@ public:
 
     // --------------------------------------------------------------------------------------------
     WPN_EXAMINE void
-    add_connection(Connection& con) noexcept { m_connections.push_back(con); }
+    add_connection(Connection& con) noexcept;
     // this is called when Connection has been explicitely
     // instantiated from a QML context
 
@@ -975,14 +1719,124 @@ public:
         return nullptr;
     }
 
+    // --------------------------------------------------------------------------------------------
+    void
+    update();
+    // requests a new execution plan, this has to be called from the Qt/GUI thread
+    // each time the Graph topology changes (connections, channels...)
+    // edits made within the same event loop iteration are compiled only once
+
+    Q_INVOKABLE void
+    compile();
+    // compiles a new execution plan from the Graph's direct subnodes
+    // and publishes it to the audio thread
+    // it does nothing until Graph is complete
+
     // --------------------------------------------------------------------------------------------    
     vector_t
     run() noexcept;
     // processes the graph from all of its direct subnodes
+    // picking up the latest published execution plan, if any
+
+    WPN_AUDIOTHREAD vector_t
+    next() noexcept;
+    // picks up the latest published execution plan, if any
+    // returns the number of frames the next run will process
 
     vector_t
-    run(Node& target) noexcept;
-    // processes the graph from a specific node
+    run(Graph::plan const& plan) noexcept;
+    // iterates over a compiled execution plan
+
+    WPN_AUDIOTHREAD void
+    run(Graph::plan const& plan, Graph::task const& task, vector_t nframes) noexcept;
+    // processes a single task of the execution plan
+
+    WPN_AUDIOTHREAD void
+    rotate(Graph::plan const& plan) noexcept;
+    // binds pipelined Ports to their current run's buffers (see Graph::ring)
+
+    WPN_AUDIOTHREAD void
+    pull(Connection& connection, vector_t nframes) noexcept;
+    // mixes a Connection outside of the plan's operations (see Node::process)
+    // along its compiled route in the current plan, if any
+
+    // --------------------------------------------------------------------------------------------
+    Q_INVOKABLE quint64
+    clock() const noexcept { return m_clock.load(std::memory_order_relaxed); }
+    // returns the number of frames processed by the audio thread,
+    // this is the time base of scheduled Port values (see Port::set_value)
+
+    // --------------------------------------------------------------------------------------------
+    int
+    threads() const noexcept { return m_threads; }
+
+    void
+    set_threads(int threads);
+
+    // --------------------------------------------------------------------------------------------
+    int
+    stages() const noexcept { return m_stages; }
+
+    void
+    set_stages(int stages)
+    // --------------------------------------------------------------------------------------------
+    {
+        if (std::max(1, stages) != m_stages) {
+            m_stages = std::max(1, stages);
+            update();
+        }
+    }
+
+    // --------------------------------------------------------------------------------------------
+    int
+    latency() const noexcept { return static_cast<int>(m_latency.load()); }
+    // returns the latency of the current plan, in frames
+    // this may be called from any thread (e.g. i/o backends latency callbacks)
+
+    Q_SIGNAL void
+    latencyChanged(int);
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    hugepages() const noexcept { return m_hugepages; }
+
+    void
+    set_hugepages(bool hugepages) { m_hugepages = hugepages; }
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    mlock() const noexcept { return m_mlock; }
+
+    void
+    set_mlock(bool mlock) { m_mlock = mlock; }
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    suspend() const noexcept { return m_suspend; }
+
+    void
+    set_suspend(bool suspend)
+    // --------------------------------------------------------------------------------------------
+    {
+        if (suspend != m_suspend) {
+            m_suspend = suspend;
+            update();
+        }
+    }
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    accurate() const noexcept { return m_accurate; }
+
+    void
+    set_accurate(bool accurate)
+    // --------------------------------------------------------------------------------------------
+    {
+        if (accurate != m_accurate) {
+            m_accurate = accurate;
+            update();
+        }
+    }
 
     // --------------------------------------------------------------------------------------------
     uint16_t
@@ -991,12 +1845,50 @@ public:
 
     // --------------------------------------------------------------------------------------------
     void
-    set_vector(uint16_t vector) { m_properties.vector = vector; }
+    set_vector(uint16_t vector)
+    // --------------------------------------------------------------------------------------------
+    {
+        if (vector != m_properties.vector) {
+            m_properties.vector = vector;
+            // audio buffers will be reallocated with the next plan
+            update();
+        }
+    }
 
     // --------------------------------------------------------------------------------------------
     Q_SIGNAL void
     vectorChanged(vector_t);
 
+    // --------------------------------------------------------------------------------------------
+    int
+    block() const noexcept { return m_block; }
+
+    void
+    set_block(int block)
+    // --------------------------------------------------------------------------------------------
+    {
+        m_block = std::max(0, block);
+
+        if (m_block)
+             set_vector(m_block);
+        else if (m_period)
+             set_vector(m_period);
+    }
+
+    // --------------------------------------------------------------------------------------------
+    void
+    set_period(vector_t period)
+    // called by i/o backends whenever their period (buffer size) changes,
+    // from the Graph's thread: backend threads queue it (see JackExternal)
+    // until then, External::process adapts the new period to the current blocks
+    // --------------------------------------------------------------------------------------------
+    {
+        m_period = period;
+        set_vector(m_block ? m_block : period);
+        // latency may change even if vector doesn't
+        update();
+    }
+
     // --------------------------------------------------------------------------------------------
     sample_t
     rate() noexcept { return m_properties.rate; }
@@ -1004,14 +1896,10 @@ public:
 
     // --------------------------------------------------------------------------------------------
     void
-    set_rate(sample_t rate)
-    // --------------------------------------------------------------------------------------------
-    {        
-        if (rate != m_properties.rate) {
-            m_properties.rate = rate;
-            emit s_instance->rateChanged(rate);
-        }
-    }
+    set_rate(sample_t rate);
+    // Nodes that are not part of the current plan (see Graph::compile)
+    // are notified when they become reachable again
+    // this has to be called from the Graph's thread, backend threads queue it (see JackExternal)
 
     // --------------------------------------------------------------------------------------------
     External*
@@ -1093,8 +1981,167 @@ private:
     s_instance;
 
     // --------------------------------------------------------------------------------------------
-    std::vector<Connection>
+    void
+    publish(Graph::plan* plan);
+    // hands over a new plan to the audio thread
+
+    void
+    retire(Connection& connection);
+    // removes Connection from the Graph, it will only be destroyed
+    // when the audio thread doesn't run any plan referencing it anymore
+
+    void
+    collect();
+    // reclaims the plans and Connections the audio thread is done with
+
+    // --------------------------------------------------------------------------------------------
+    void
+    compile(Graph::plan& plan, Node& node, std::vector<Node*>& visited);
+    // depth-first traversal of node's upstream graph,
+    // appending operations in topological order
+
+    std::unordered_map<Connection*, bool>
+    reduce(Graph::plan& plan, Node& node);
+    // appends the tasks summing the outputs of a Dispatch::Parallel Node's subnodes,
+    // returns the reduced Connections: true for the ones whose source ends up holding the sum,
+    // mixed without their gain, false for the ones that don't have to be mixed anymore
+
+    void
+    fuse(Graph::plan& plan);
+    // merges the tasks of linear chains of Nodes processing segments, or of Midi filters
+
+    void
+    pipeline(Graph::plan& plan);
+    // cuts plan's tasks into stages, if pipelining is enabled
+
+    void
+    audible(Node& node, std::vector<Node*>& visited);
+    // depth-first traversal of node's upstream graph, along unmuted active Connections
+
+    void
+    drain(uint64_t since);
+    // recompiles once the first draining Node's tail has been processed (see m_drain),
+    // since: the audio clock at the previous check, UINT64_MAX for the first one
+    // the timer is re-armed with the remaining time only while the audio clock moves,
+    // a stopped backend is polled, without recompiling
+
+    void
+    routes(Graph::plan& plan);
+    // compiles all active Connections' routings into plan's cable table
+
+    void
+    expand();
+    // infers the number of channels of the Ports declared without any,
+    // and routes the Connections of Dispatch::Split/Merge Nodes accordingly
+
+    void
+    schedule(Graph::plan& plan);
+    // computes plan's task dependencies
+
+    // --------------------------------------------------------------------------------------------
+    void
+    allocate(Graph::plan& plan);
+    // lays out all Audio Port buffers in a single arena
+    // the previous plan's arena is kept if the layout hasn't changed
+
+    WPN_AUDIOTHREAD void
+    bind(Graph::plan const& plan) noexcept;
+    // points Audio Ports and Node pools to plan's arena
+
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD void
+    run(Graph::operation const* begin, Graph::operation const* end, vector_t nframes) noexcept;
+
+    WPN_AUDIOTHREAD void
+    split(Node& node, vector_t nframes) noexcept;
+    // processes node's block in segments, cut at its inputs' events and scheduled values
+
+    WPN_AUDIOTHREAD void
+    tile(Graph::operation const* begin, Graph::operation const* end, vector_t nframes) noexcept;
+    // processes a fused chain's operations, one tile of frames at a time (see Graph::fuse)
+
+    WPN_AUDIOTHREAD void
+    transform(Graph::operation const* begin, Graph::operation const* end) noexcept;
+    // processes a chain of Midi filters' events in a single pass (see Graph::fuse)
+
+    // --------------------------------------------------------------------------------------------
+    std::list<Connection>
     m_connections;
+    // Ports and execution plan keep pointers to these,
+    // they have to remain stable when connecting/disconnecting
+
+    // --------------------------------------------------------------------------------------------
+    std::atomic<Graph::plan*>
+    m_pending {nullptr};
+    // published by the Qt/GUI thread, picked up by the audio thread
+
+    Graph::plan*
+    m_current = nullptr;
+    // the plan being run by the audio thread
+
+    wpn114::arena*
+    m_arena = nullptr;
+    // the arena Ports are currently bound to (audio thread)
+
+    std::atomic<uint64_t>
+    m_epoch {0};
+    // epoch of the plan being run by the audio thread
+
+    std::atomic<uint64_t>
+    m_clock {0};
+    // number of frames processed by the audio thread, used to time suspensions
+
+    uint64_t
+    m_drain = UINT64_MAX;
+    // end of the first draining Node's tail, in frames (see drain)
+
+    uint32_t
+    m_drain_timer = 0;
+    // each compilation cancels the previous drain timer
+
+    uint64_t
+    m_runs = 0;
+    // number of pipelined runs processed by the audio thread, selects ring buffers
+
+    std::atomic<uint32_t>
+    m_latency {0};
+
+    // --------------------------------------------------------------------------------------------
+    std::list<Graph::plan*>
+    m_plans;
+    // all published plans, not reclaimed yet
+
+    std::list<std::pair<uint64_t, std::list<Connection>>>
+    m_retired;
+    // removed Connections, tagged with the first epoch that doesn't reference them
+
+    uint64_t
+    m_epochs = 0;
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    m_complete = false,
+    m_update = false;
+
+    // --------------------------------------------------------------------------------------------
+    Executor*
+    m_executor = nullptr;
+
+    int
+    m_threads = 1,
+    m_stages = 1,
+    m_block = 0;
+
+    vector_t
+    m_period = 0;
+    // i/o backend's period, 0 if unknown
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    m_hugepages = false,
+    m_mlock = false,
+    m_suspend = false,
+    m_accurate = false;
 
     // --------------------------------------------------------------------------------------------
     std::vector<Node*>
@@ -1154,6 +2201,25 @@ class Node : public QObject, public QQmlParserStatus, public QQmlPropertyValueSo
      * \brief the list of subnodes that are connected to this Node
     */
 
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY(int tail MEMBER m_tail)
+    /*!
+     * \property Node::tail
+     * \brief number of frames Node keeps outputting signal once its default inputs are silent
+     * when they have been silent for that long, Node isn't processed anymore,
+     * and its outputs are flagged silent, until one of its default inputs isn't
+     * -1 (default): Node is always processed (e.g. generators)
+    */
+
+    // --------------------------------------------------------------------------------------------
+    Q_PROPERTY(bool sink READ sink WRITE set_sink)
+    /*!
+     * \property Node::sink
+     * \brief marks Node as an endpoint of the Graph (i/o outputs, analysis...)
+     * only the Nodes from which a sink can be reached are part of the execution plan,
+     * Nodes without any output are always considered as sinks
+    */
+
     // --------------------------------------------------------------------------------------------
     Q_PROPERTY(Dispatch::Values dispatch MEMBER m_dispatch)
     /*!
@@ -1206,6 +2272,8 @@ public:
         switch(m_dispatch)
         {
         case Dispatch::Values::Upwards:
+        case Dispatch::Values::Parallel:
+        case Dispatch::Values::Expand:
         {
             // subnode's chain out connects to this Node
             for (auto& subnode : m_subnodes) {
@@ -1215,6 +2283,28 @@ public:
             }
             break;
         }
+        case Dispatch::Values::Split:
+        {
+            // subnodes take their channels off this Node's default output, in order
+            // Connections are routed once their number of channels is known (see Graph::expand)
+            auto source = default_port(Port::Audio, Polarity::Output);
+
+            for (auto& subnode : m_subnodes)
+                if (auto dest = subnode->default_port(Port::Audio, Polarity::Input); source && dest)
+                    Graph::instance().connect(*source, *dest);
+            break;
+        }
+        case Dispatch::Values::Merge:
+        {
+            // subnodes' chain outs are appended to this Node's default input, in order
+            auto dest = default_port(Port::Audio, Polarity::Input);
+
+            for (auto& subnode : m_subnodes)
+                if (auto source = subnode->chainout().default_port(Port::Audio, Polarity::Output);
+                    source && dest)
+                    Graph::instance().connect(*source, *dest);
+            break;
+        }
         case Dispatch::Values::Chain:
         {
             // connect this Node default outputs to first subnode
@@ -1225,7 +2315,7 @@ public:
                 return;
 
             // chain the following subnodes, until last is reached
-            for (int n = 0; n < m_subnodes.count(); ++n) {
+            for (int n = 0; n+1 < m_subnodes.count(); ++n) {
                 auto& source = m_subnodes[n]->chainout();
                 auto& dest = *m_subnodes[n+1];
                 Graph::instance().connect(source, dest);
@@ -1267,6 +2357,21 @@ public:
     { Q_UNUSED(inputs) Q_UNUSED(outputs) Q_UNUSED(nframes) }
     // the main processing function to override
 
+    virtual void
+    rwrite(pool& inputs, pool& outputs, vector_t offset, vector_t nframes)
+    { Q_UNUSED(offset) rwrite(inputs, outputs, nframes); }
+    // processes frames [offset, offset+nframes) of the current block
+    // Nodes setting m_accurate override this one instead, their blocks may then be split
+    // (see Graph::accurate): events keep their block frame, and block-constant Ports
+    // have to be read with scalar(), which may change in between two segments
+
+    virtual bool
+    rtransform(midi_t& event, pool& inputs)
+    { Q_UNUSED(event) Q_UNUSED(inputs) return true; }
+    // processes a single event in place, returns false if it has to be dropped
+    // Nodes setting m_transform override this one, and call it from rwrite: chains of them
+    // then process each event in a single pass, writing into the last one's output only
+
     virtual void
     on_rate_changed(sample_t rate) { Q_UNUSED(rate) }
     // this can be overriden and will be called each time the sample rate changes
@@ -1291,6 +2396,25 @@ public:
              port->set_muted(muted);
     }
 
+    // --------------------------------------------------------------------------------------------
+    bool
+    sink() const noexcept { return m_sink; }
+
+    bool
+    culled() const noexcept { return m_culled; }
+    // returns true if Node can't reach any sink, and isn't processed
+
+    void
+    set_sink(bool sink)
+    // --------------------------------------------------------------------------------------------
+    {
+        if (sink == m_sink)
+            return;
+
+        m_sink = sink;
+        Graph::instance().update();
+    }
+
     // --------------------------------------------------------------------------------------------
     void
     set_active(bool active) noexcept
@@ -1335,9 +2459,11 @@ public:
     default_port(Polarity polarity) noexcept
     // --------------------------------------------------------------------------------------------
     {
-        if  (Port* default_audio_port = default_port(Port::Audio, polarity))
-             return default_audio_port;
-        else return default_port(Port::Midi_1_0, polarity);
+        for (auto type : { Port::Audio, Port::Midi_1_0, Port::Midi_2_0, Port::Trigger, Port::Gate })
+            if (Port* port = default_port(type, polarity))
+                return port;
+
+        return nullptr;
     }
 
     // --------------------------------------------------------------------------------------------
@@ -1393,6 +2519,10 @@ public:
     {
         switch(m_dispatch) {
         case Dispatch::Values::Upwards:
+        case Dispatch::Values::Parallel:
+        case Dispatch::Values::Split:
+        case Dispatch::Values::Merge:
+        case Dispatch::Values::Expand:
             return *this;
         case Dispatch::Values::Chain:
             if (m_subnodes.empty())
@@ -1476,49 +2606,41 @@ public:
         reinterpret_cast<Node*>(list)->clear_subnodes();
     }
 
-    // --------------------------------------------------------------------------------------------
-    bool
-    processed() const { return m_processed; }
-
-    // --------------------------------------------------------------------------------------------
-    void
-    set_processed(bool processed)
-    // --------------------------------------------------------------------------------------------
-    {
-        m_processed = processed;
-        // reset midi outputs
-        if (processed == false)
-            for (auto& output : m_output_ports)
-                if (output->type() == Port::Midi_1_0)
-                    output->reset();
-    }
-
     // --------------------------------------------------------------------------------------------
     WPN_AUDIOTHREAD void
     process(vector_t nframes) noexcept
-    // pre-processing main function
+    // processes this Node only, outside of the Graph's execution plan
+    // upstream Nodes are expected to have already been processed
     // --------------------------------------------------------------------------------------------
     {
-        m_processed = true;
-
         for (auto& port : m_input_ports) {
-            // we start by pulling the input Port value (if Audio)
+            // we start by pulling the input Port value (if Audio/Control)
             // that has been (or not) set asynchronously from the user thread
+            // only the channels bound for the current run are touched, the user thread
+            // may already have changed nchannels/capacity for the next plan
             if  (port->type() == Port::Audio)
-                 port->pull_value(nframes);
+                 port->pull_value(nframes, port->bound_nchannels());
+            else if (port->type() == Port::Control)
+                 port->pull_control(port->bound_nchannels());
             else port->reset();
-            // then, we pull all Port connections (we'll see later for multithreading)
+            // then, we mix all active Port connections
 
             for (auto& connection : port->connections())
                 if (connection->active())
-                    connection->pull(nframes);
+                    Graph::instance().pull(*connection, nframes);
         }
 
-        rwrite(m_input_pool, m_output_pool, nframes);
+        expand(0, nframes);
     }
 
 protected:
 
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD void
+    expand(vector_t offset, vector_t nframes) noexcept;
+    // calls rwrite once, or once per lane for Dispatch::Expand Nodes:
+    // lane n sees channel n of each Port as its first one (channel 0 if Port has fewer channels)
+
     // --------------------------------------------------------------------------------------------
     void
     allocate_ports(vector_t nframes)
@@ -1538,6 +2660,19 @@ protected:
     allocate_pools();
     // defined in .cpp as not to break the ODR
 
+    // --------------------------------------------------------------------------------------------
+    WPN_AUDIOTHREAD bool
+    idle(vector_t nframes) noexcept;
+    // returns true if Node can be skipped for the current run (see tail property)
+
+    WPN_AUDIOTHREAD void
+    silence(vector_t nframes) noexcept;
+    // zeroes and flags the Audio output channels of a skipped Node, if not silent already
+
+    WPN_AUDIOTHREAD void
+    detect_silence(vector_t nframes) noexcept;
+    // flags the Audio output channels holding only zeros, once Node has been processed
+
     // --------------------------------------------------------------------------------------------
     pool&
     input_pools() noexcept { return m_input_pool; }
@@ -1551,9 +2686,14 @@ protected:
     m_input_pool,
     m_output_pool;
 
+    pool
+    m_lane_inputs,
+    m_lane_outputs;
+    // Dispatch::Expand: the pools passed to rwrite, offset to the current lane's channels
+
     // --------------------------------------------------------------------------------------------
     Spatial*
-    m_spatial;
+    m_spatial = nullptr;
 
     // --------------------------------------------------------------------------------------------
     std::vector<Port*>
@@ -1564,16 +2704,60 @@ protected:
     QVector<Node*>
     m_subnodes;
 
+    // --------------------------------------------------------------------------------------------
+    std::vector<Node*>
+    m_dependencies;
+    // Nodes whose Ports are read directly, outside of any Connection (see SpatialProcessor),
+    // they're always processed before this one, by the same stage
+
     // --------------------------------------------------------------------------------------------
     bool
     m_muted = false,
-    m_active = true,
-    m_processed = false;
+    m_active = true;
 
     // --------------------------------------------------------------------------------------------
     Dispatch::Values
     m_dispatch = Dispatch::Values::Upwards;
 
+    // --------------------------------------------------------------------------------------------
+    bool
+    m_sink = false,
+    m_culled = false,
+    m_rate_pending = false;
+    // culled: Node can't reach any sink, it isn't part of the current plan
+    // rate_pending: the sample rate has changed while Node was culled
+
+    bool
+    m_suspended = false,
+    m_draining = false;
+    // draining: Node can't be heard anymore (see Graph::suspend),
+    // it remains in the plan until m_drained to process its tail
+
+    uint64_t
+    m_drained = 0;
+
+    // --------------------------------------------------------------------------------------------
+    bool
+    m_accurate = false;
+    // set by Nodes processing segments (see Node::rwrite)
+
+    bool
+    m_transform = false;
+    // set by Midi filters, with a single Midi input and output (see Node::rtransform)
+
+    bool
+    m_expandable = false;
+    // set by Nodes processing a single channel, without any state of their own:
+    // they can be run once per lane (see Dispatch::Expand)
+
+    // --------------------------------------------------------------------------------------------
+    int
+    m_tail = -1;
+
+    int64_t
+    m_idle = 0;
+    // number of frames default inputs have been silent for (audio thread)
+
     // --------------------------------------------------------------------------------------------
     Node*
     m_parent = nullptr;
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <iterator>
 #include <atomic>
+#include <algorithm>
 #include <memory.h>
 
 using vector_t = uint16_t;
@@ -10,17 +11,24 @@ using byte_t = uint8_t;
 
 //-------------------------------------------------------------------------------------------------
 struct midi_t
+// a single midi event, its payload is stored inline:
+// channel messages fit in a single 8-byte slot, longer ones (e.g. sysex)
+// continue over the next slots of their midibuffer
 //-------------------------------------------------------------------------------------------------
 {
     vector_t frame;
     byte_t status;
     byte_t nbytes;
-    byte_t* data;
+    byte_t data[4];
 };
 
+static_assert(sizeof(midi_t) == 8, "midi_t has to fit in a single 8-byte slot");
+
 //-------------------------------------------------------------------------------------------------
 class midibuffer
-// a fixed capacity byte vector holding midi_t events of different sizes
+// a fixed capacity array of midi_t slots, holding events of different sizes
+// it holds no pointers: events are located by their offsets, in slots, which makes
+// copies (see push, append, merge) plain memcpys of contiguous runs, and indexing O(1)
 //-------------------------------------------------------------------------------------------------
 {
 
@@ -30,7 +38,21 @@ public:
     midibuffer(size_t nbytes) { allocate(nbytes); }
 
     //---------------------------------------------------------------------------------------------
-    ~midibuffer() { delete[] m_data; }
+    ~midibuffer()
+    {
+        delete[] m_data;
+        delete[] m_offsets;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    static size_t
+    nslots(byte_t nbytes)
+    // number of slots taken by an event holding nbytes of payload
+    //---------------------------------------------------------------------------------------------
+    {
+        constexpr size_t inline_bytes = sizeof(midi_t::data);
+        return nbytes <= inline_bytes ? 1 : 1+(nbytes-inline_bytes+sizeof(midi_t)-1)/sizeof(midi_t);
+    }
 
     //---------------------------------------------------------------------------------------------
     class iterator : public std::iterator<std::input_iterator_tag, midi_t>
@@ -38,20 +60,19 @@ public:
     {
     public:
         //-----------------------------------------------------------------------------------------
-        iterator(byte_t* data) : m_data(data) {}
+        iterator(midi_t* data) : m_data(data) {}
 
         //-----------------------------------------------------------------------------------------
         iterator&
         operator++()
         {
-            byte_t nbytes = m_data[3];
-            m_data += sizeof(midi_t)+nbytes;
+            m_data += nslots(m_data->nbytes);
             return *this;
         }
 
         //-----------------------------------------------------------------------------------------
         midi_t&
-        operator*() { return *reinterpret_cast<midi_t*>(m_data); }
+        operator*() { return *m_data; }
 
         //-----------------------------------------------------------------------------------------
         bool
@@ -62,7 +83,7 @@ public:
         operator!=(iterator const& rhs) { return !operator==(rhs); }
 
     private:
-        byte_t*
+        midi_t*
         m_data = nullptr;
     };
 
@@ -72,43 +93,54 @@ public:
 
     //---------------------------------------------------------------------------------------------
     iterator
-    end() { return iterator(&(m_data[m_index.load()])); }
+    end() { return iterator(m_data+m_index.load()); }
 
     //---------------------------------------------------------------------------------------------
     void
     allocate(size_t nbytes)
+    // capacity is given in bytes, a single event takes at least sizeof(midi_t)
     //---------------------------------------------------------------------------------------------
     {
-        m_data = new byte_t[nbytes]();
-        m_capacity.store(nbytes);
+        auto capacity = std::max<size_t>(nbytes/sizeof(midi_t), 1);
+        m_data = new midi_t[capacity]();
+        m_offsets = new uint32_t[capacity]();
+        m_capacity.store(capacity);
     }
 
     //---------------------------------------------------------------------------------------------
     vector_t
     count() const { return m_count.load(); }
 
+    //---------------------------------------------------------------------------------------------
+    bool
+    empty() const { return m_index.load() == 0; }
+
     //---------------------------------------------------------------------------------------------
     void
-    clear() { m_index.store(0); }
+    clear()
+    {
+        m_index.store(0);
+        m_count.store(0);
+    }
 
     //---------------------------------------------------------------------------------------------
     midi_t*
     reserve(byte_t nbytes)
+    // appends a zeroed event with nbytes of payload, returns nullptr if it doesn't fit
     //---------------------------------------------------------------------------------------------
     {
-        byte_t msz = sizeof(midi_t);
-        size_t idx = m_index.load();
-        size_t tmp = idx+msz+nbytes;
+        auto slots = nslots(nbytes);
+        auto idx = m_index.load();
 
-        if (tmp > m_capacity.load())
+        if (idx+slots > m_capacity.load())
             return nullptr;
 
-        midi_t* mt = reinterpret_cast<midi_t*>(&m_data[idx]);
-        memset(mt, 0, msz+nbytes);
+        midi_t* mt = m_data+idx;
+        memset(mt, 0, sizeof(midi_t)*slots);
         mt->nbytes = nbytes;
-        mt->data = &(m_data[idx+msz]);
 
-        m_index.store(tmp);
+        m_offsets[m_count.load()] = static_cast<uint32_t>(idx);
+        m_index.store(idx+slots);
         m_count++;
         return mt;
     }
@@ -119,6 +151,9 @@ public:
     //---------------------------------------------------------------------------------------------
     {
         midi_t* mt = reserve(nbytes);
+        if (mt == nullptr)
+            return nullptr;
+
         mt->status = status;
         mt->frame = frame;
         memcpy(mt->data, data, nbytes);
@@ -131,6 +166,9 @@ public:
     //---------------------------------------------------------------------------------------------
     {
         midi_t* mt = reserve(2);
+        if (mt == nullptr)
+            return nullptr;
+
         mt->status = status;
         mt->frame = frame;
         mt->data[0] = b1;
@@ -141,30 +179,130 @@ public:
     // --------------------------------------------------------------------------------------------
     bool
     push(midi_t const& event)
+    // event has to be stored in a midibuffer, or hold its payload inline
     // --------------------------------------------------------------------------------------------
     {
         if (midi_t* mt = reserve(event.nbytes)) {
-            memcpy(mt, &event, sizeof(midi_t)+event.nbytes);
+            memcpy(mt, &event, sizeof(midi_t)*nslots(event.nbytes));
             return true;
         }   else return false;
     }
 
+    // --------------------------------------------------------------------------------------------
+    size_t
+    append(midibuffer const& source)
+    // appends source's events with a single copy,
+    // the latest ones are dropped if they don't fit, returns the number of appended ones
+    // --------------------------------------------------------------------------------------------
+    {
+        auto idx = m_index.load(), count = static_cast<size_t>(m_count.load());
+        size_t nevents, slots;
+        fit(source, nevents, slots);
+
+        if (nevents == 0)
+            return 0;
+
+        memcpy(m_data+idx, source.m_data, sizeof(midi_t)*slots);
+
+        for (size_t e = 0; e < nevents; ++e)
+             m_offsets[count+e] = source.m_offsets[e]+static_cast<uint32_t>(idx);
+
+        m_index.store(idx+slots);
+        m_count.store(static_cast<uint16_t>(count+nevents));
+        return nevents;
+    }
+
+    // --------------------------------------------------------------------------------------------
+    size_t
+    merge(midibuffer const& source)
+    // merges source's events into this buffer, both being sorted by frame, so that it remains
+    // sorted: merging the buffers of several sources one after the other (see Connection::pull)
+    // yields a single frame-ordered stream
+    // - lists are merged in place, starting from the back, events only move towards the end
+    // - events sharing the same frame keep their order, this buffer's ones first
+    // - source events following this buffer's last one are appended with a single copy
+    // the latest source events are dropped if they don't fit, returns the number of merged ones
+    // --------------------------------------------------------------------------------------------
+    {
+        auto idx = m_index.load(), count = static_cast<size_t>(m_count.load());
+
+        if (count == 0 || source.m_count.load() == 0 ||
+            m_data[m_offsets[count-1]].frame <= source.m_data[0].frame)
+            return append(source);
+
+        size_t nevents, slots;
+        fit(source, nevents, slots);
+
+        // invariant: e = d+s, the offsets of the remaining events [0, d) are never overwritten
+        size_t d = count, s = nevents, e = count+nevents;
+        size_t n = idx+slots, dend = idx;
+
+        while (s > 0)
+        {
+            auto sbegin = source.m_offsets[s-1];
+            auto send = s < source.m_count.load() ? source.m_offsets[s] : source.m_index.load();
+
+            if (d > 0 && m_data[m_offsets[d-1]].frame > source.m_data[sbegin].frame) {
+                auto dbegin = m_offsets[--d];
+                n -= dend-dbegin;
+                memmove(m_data+n, m_data+dbegin, sizeof(midi_t)*(dend-dbegin));
+                dend = dbegin;
+            }
+            else {
+                n -= send-sbegin;
+                memcpy(m_data+n, source.m_data+sbegin, sizeof(midi_t)*(send-sbegin));
+                s--;
+            }
+
+            m_offsets[--e] = static_cast<uint32_t>(n);
+        }
+
+        m_index.store(idx+slots);
+        m_count.store(static_cast<uint16_t>(count+nevents));
+        return nevents;
+    }
+
     //---------------------------------------------------------------------------------------------
     midi_t*
     operator[](vector_t index)
+    // index-th event, nullptr if out of range
+    //---------------------------------------------------------------------------------------------
     {
-        return nullptr;
+        return index < m_count.load() ? m_data+m_offsets[index] : nullptr;
     }
 
 private:
+    //---------------------------------------------------------------------------------------------
+    void
+    fit(midibuffer const& source, size_t& nevents, size_t& slots) const
+    // number of source's first events (and their slots) fitting in the remaining capacity
+    //---------------------------------------------------------------------------------------------
+    {
+        auto room = m_capacity.load()-m_index.load();
+        nevents = source.m_count.load();
+        slots = source.m_index.load();
+
+        if (slots > room) {
+            // events [0, n) fit if event n starts within room
+            nevents = std::upper_bound(source.m_offsets, source.m_offsets+nevents,
+                                       static_cast<uint32_t>(room))-source.m_offsets-1;
+            slots = source.m_offsets[nevents];
+        }
+    }
+
     //---------------------------------------------------------------------------------------------
     std::atomic<size_t>
     m_index {0}, m_capacity{0};
+    // in slots
 
     std::atomic<uint16_t>
     m_count {0};
 
     //---------------------------------------------------------------------------------------------
-    byte_t*
+    midi_t*
     m_data = nullptr;
+
+    uint32_t*
+    m_offsets = nullptr;
+    // each event's first slot
 };
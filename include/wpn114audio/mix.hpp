@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+using sample_t = float;
+using vector_t = uint16_t;
+
+namespace wpn114 {
+namespace mix {
+
+//-------------------------------------------------------------------------------------------------
+// vectorized accumulation kernels, used by Connection::pull
+// the best instruction set available is selected once, at startup (see isa())
+// all kernels produce the exact same output as the scalar version
+// (no fused multiply-add, same operation order)
+//-------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------
+enum class isa : uint8_t
+//-------------------------------------------------------------------------------------------------
+{
+    Scalar  = 0,
+    SSE2    = 1,
+    AVX2    = 2,
+    AVX512  = 3
+};
+
+//-------------------------------------------------------------------------------------------------
+enum variant : uint8_t
+// specialized at plan-compile time, from Connection's mul/add values
+//-------------------------------------------------------------------------------------------------
+{
+    Accumulate  = 0,
+    // dest += source (unity gain, zero add)
+
+    Scale       = 1,
+    // dest += source*mul
+
+    Offset      = 2,
+    // dest += source+add
+
+    Affine      = 3
+    // dest += source*mul+add
+};
+
+//-------------------------------------------------------------------------------------------------
+using kernel = void(*)(sample_t* dest, sample_t const* source,
+                       sample_t mul, sample_t add, vector_t nframes) noexcept;
+
+//-------------------------------------------------------------------------------------------------
+inline variant
+select(sample_t mul, sample_t add) noexcept
+// returns the cheapest variant for mul/add
+//-------------------------------------------------------------------------------------------------
+{
+    return static_cast<variant>((mul != 1) | ((add != 0) << 1));
+}
+
+//-------------------------------------------------------------------------------------------------
+isa
+current() noexcept;
+// returns the instruction set selected for this CPU
+
+kernel
+get(variant v) noexcept;
+// returns the kernel for the current instruction set
+
+kernel
+get(variant v, isa target) noexcept;
+// returns the kernel for a specific instruction set
+// or nullptr if it is not supported by this CPU (or this build)
+
+const char*
+name(isa target) noexcept;
+
+//-------------------------------------------------------------------------------------------------
+bool
+zero(sample_t const* buffer, vector_t nframes) noexcept;
+// returns true if all samples are zero (used for silence detection)
+// exits on the first non-zero vector, this is cheap on a non-silent buffer
+
+}
+}
@@ -12,12 +12,13 @@ class Spatial : public Node
 {
     Q_OBJECT
 
-    WPN_DECLARE_AUDIO_INPUT   (h_orientation, 1)
-    WPN_DECLARE_AUDIO_INPUT   (v_orientation, 1)
-    WPN_DECLARE_AUDIO_INPUT   (directivity, 1)
-    WPN_DECLARE_AUDIO_INPUT   (x, 1)
-    WPN_DECLARE_AUDIO_INPUT   (y, 1)
-    WPN_DECLARE_AUDIO_INPUT   (z, 1)
+    // slowly moving parameters: these are evaluated once per block
+    WPN_DECLARE_CONTROL_INPUT   (h_orientation, 1)
+    WPN_DECLARE_CONTROL_INPUT   (v_orientation, 1)
+    WPN_DECLARE_CONTROL_INPUT   (directivity, 1)
+    WPN_DECLARE_CONTROL_INPUT   (x, 1)
+    WPN_DECLARE_CONTROL_INPUT   (y, 1)
+    WPN_DECLARE_CONTROL_INPUT   (z, 1)
 
 public:
 
@@ -58,6 +59,13 @@ public:
         m_h_orientation.set_nchannels(nchannels);
         m_v_orientation.set_nchannels(nchannels);
         m_directivity.set_nchannels(nchannels);
+
+        // these are read directly by the SpatialProcessor
+        // outside of the Graph's Connections, upstream Nodes have to be processed
+        for (auto& port : m_input_ports)
+             port->set_persistent(true);
+
+        m_sink = true;
     }
 
     // --------------------------------------------------------------------------------------------
@@ -101,6 +109,7 @@ public:
 
         for (auto& node : m_subnodes) {
             m_spatial_inputs.push_back(node->spatial());
+            m_dependencies.push_back(node->spatial());
             nchannels += node->spatial()->nchannels();
         }
 
@@ -114,9 +123,7 @@ public:
     rwrite(pool &inputs, pool &outputs, vector_t nframes) override
     //---------------------------------------------------------------------------------------------
     {
-        // otherwise, spatial node won't be processed in time
-        for (auto& input: m_spatial_inputs)
-             input->process(nframes);
+        // spatial nodes are processed by the plan, before this one (see m_dependencies)
     }
 
 protected:    
@@ -153,11 +160,11 @@ public:
     {
         auto in     = inputs.audio[0][0]; // the input buffer (mono)
         auto out    = outputs.audio[0]; // the output buffer (stereo)
-        auto x      = m_spatial_inputs[0]->m_x.buffer<audiobuffer_t>()[0];
+        auto x      = m_spatial_inputs[0]->m_x.buffer<controlbuffer_t>()[0];
 
         for (vector_t f = 0; f < nframes; ++f) {
-            out[0][f] = sqrt(in[f]*x[f]);
-            out[1][f] = sqrt(in[f]*(1-x[f]));
+            out[0][f] = sqrt(in[f]*x.at(f));
+            out[1][f] = sqrt(in[f]*(1-x.at(f)));
         }
     }
 };
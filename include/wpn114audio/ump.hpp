@@ -0,0 +1,352 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <memory.h>
+
+#include <wpn114audio/midi.hpp>
+
+//-------------------------------------------------------------------------------------------------
+class umpbuffer
+// a fixed capacity list of Universal MIDI Packets (MIDI 2.0), sorted by frame
+// packets are stored as a structure of arrays: their frames, their first words, and their
+// second words (zero for 32-bit packets), filters then compare the first words of whole
+// blocks at once (see filter), and compilers vectorize them
+// - MIDI 1.0 channel voice, system and sysex messages are converted to and from
+//   midibuffer events (see read, write)
+// - MIDI 2.0 channel voice messages are kept with their full resolution, they're only
+//   converted down when written to a midibuffer
+//-------------------------------------------------------------------------------------------------
+{
+
+public:
+    //---------------------------------------------------------------------------------------------
+    enum Type : uint8_t
+    // message type, first word's top 4 bits
+    //---------------------------------------------------------------------------------------------
+    {
+        Utility     = 0x0,
+        System      = 0x1,
+        Midi1       = 0x2,
+        Data64      = 0x3,
+        Midi2       = 0x4,
+        Data128     = 0x5
+    };
+
+    //---------------------------------------------------------------------------------------------
+    // first word's fields, as masks for filter()
+    static constexpr uint32_t
+    type_mask       = 0xf0000000,
+    group_mask      = 0x0f000000,
+    status_mask     = 0x00f00000,
+    channel_mask    = 0x000f0000,
+    index_mask      = 0x0000ff00;
+    // index: note number (notes, pressure), controller, or first data byte
+
+    //---------------------------------------------------------------------------------------------
+    static constexpr uint32_t
+    word(Type type, byte_t group, byte_t status, byte_t b1 = 0, byte_t b2 = 0)
+    //---------------------------------------------------------------------------------------------
+    {
+        return static_cast<uint32_t>(type) << 28 | static_cast<uint32_t>(group & 0xf) << 24 |
+               static_cast<uint32_t>(status) << 16 | static_cast<uint32_t>(b1) << 8 | b2;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    umpbuffer() {}
+    umpbuffer(size_t capacity) { allocate(capacity); }
+
+    // the buffer owns its packets
+    umpbuffer(umpbuffer const&) = delete;
+    umpbuffer& operator=(umpbuffer const&) = delete;
+
+    //---------------------------------------------------------------------------------------------
+    ~umpbuffer()
+    {
+        delete[] m_frames;
+        delete[] m_words[0];
+        delete[] m_words[1];
+    }
+
+    //---------------------------------------------------------------------------------------------
+    void
+    allocate(size_t capacity)
+    //---------------------------------------------------------------------------------------------
+    {
+        m_frames = new vector_t[capacity]();
+        m_words[0] = new uint32_t[capacity]();
+        m_words[1] = new uint32_t[capacity]();
+        m_capacity = capacity;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    size_t
+    count() const { return m_size; }
+
+    //---------------------------------------------------------------------------------------------
+    bool
+    empty() const { return m_size == 0; }
+
+    //---------------------------------------------------------------------------------------------
+    void
+    clear() { m_size = 0; }
+
+    //---------------------------------------------------------------------------------------------
+    vector_t const*
+    frames() const { return m_frames; }
+
+    uint32_t const*
+    words(size_t index) const { return m_words[index]; }
+    // index: 0 (first words), or 1 (second words of 64-bit packets)
+
+    //---------------------------------------------------------------------------------------------
+    bool
+    push(vector_t frame, uint32_t w0, uint32_t w1 = 0)
+    // appends a packet, which mustn't come earlier than the last one
+    //---------------------------------------------------------------------------------------------
+    {
+        if (m_size == m_capacity)
+            return false;
+
+        m_frames[m_size] = frame;
+        m_words[0][m_size] = w0;
+        m_words[1][m_size] = w1;
+        m_size++;
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    size_t
+    merge(umpbuffer const& source)
+    // merges source's packets into this buffer, in place, starting from the back
+    // packets sharing the same frame keep their order, this buffer's ones first,
+    // source packets following this buffer's last one are appended with a single copy per array
+    // the latest source packets are dropped if they don't fit, returns the number of merged ones
+    //---------------------------------------------------------------------------------------------
+    {
+        auto npackets = std::min(source.m_size, m_capacity-m_size);
+        size_t d = m_size, s = npackets, n = m_size+npackets;
+
+        if (npackets == 0)
+            return 0;
+
+        if (m_size == 0 || m_frames[m_size-1] <= source.m_frames[0]) {
+            memcpy(m_frames+m_size, source.m_frames, sizeof(vector_t)*npackets);
+            memcpy(m_words[0]+m_size, source.m_words[0], sizeof(uint32_t)*npackets);
+            memcpy(m_words[1]+m_size, source.m_words[1], sizeof(uint32_t)*npackets);
+            m_size += npackets;
+            return npackets;
+        }
+
+        while (s > 0)
+        {
+            auto& from = d > 0 && m_frames[d-1] > source.m_frames[s-1] ? *this : source;
+            auto p = &from == this ? --d : --s;
+            --n;
+            m_frames[n] = from.m_frames[p];
+            m_words[0][n] = from.m_words[0][p];
+            m_words[1][n] = from.m_words[1][p];
+        }
+
+        m_size += npackets;
+        return npackets;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    size_t
+    filter(uint32_t mask, uint32_t value, bool keep = true)
+    // keeps the packets whose first word's masked bits equal value (or drops them, if !keep),
+    // e.g. filter(status_mask|channel_mask, 0x00900000) keeps notes on channel 0
+    // the whole block is compared first, packets only move if some of them are dropped
+    // returns the number of remaining packets
+    //---------------------------------------------------------------------------------------------
+    {
+        auto words = m_words[0];
+        size_t nmatches = 0;
+
+        for (size_t p = 0; p < m_size; ++p)
+             nmatches += (words[p] & mask) == value;
+
+        if (nmatches == (keep ? m_size : 0))
+            return m_size;
+
+        size_t n = 0;
+
+        for (size_t p = 0; p < m_size; ++p) {
+            m_frames[n] = m_frames[p];
+            m_words[0][n] = words[p];
+            m_words[1][n] = m_words[1][p];
+            n += ((words[p] & mask) == value) == keep;
+        }
+
+        m_size = n;
+        return n;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    size_t
+    read(midibuffer& source, byte_t group = 0)
+    // appends source's events, as MIDI 1.0 channel voice, system or sysex (7-bit data) packets
+    // sysex messages are split in 6-byte packets, their F0/F7 bytes are left out
+    // returns the number of appended packets
+    //---------------------------------------------------------------------------------------------
+    {
+        auto size = m_size;
+
+        for (auto& event : source)
+        {
+            auto status = event.status;
+            byte_t b1 = event.nbytes > 0 ? event.data[0] : 0;
+            byte_t b2 = event.nbytes > 1 ? event.data[1] : 0;
+
+            if (status < 0x80 || status == 0xf7)
+                continue;
+
+            if (status < 0xf0) {
+                push(event.frame, word(Midi1, group, status, b1, b2));
+                continue;
+            }
+
+            if (status != 0xf0) {
+                push(event.frame, word(System, group, status, b1, b2));
+                continue;
+            }
+
+            size_t nbytes = event.nbytes;
+            if (nbytes && event.data[nbytes-1] == 0xf7)
+                nbytes--;
+
+            for (size_t offset = 0; offset < nbytes || offset == 0; offset += 6)
+            {
+                auto n = static_cast<byte_t>(std::min<size_t>(6, nbytes-offset));
+                byte_t part = nbytes <= 6 ? 0 : offset == 0 ? 1 : offset+6 >= nbytes ? 3 : 2;
+                byte_t bytes[6] = {};
+                memcpy(bytes, event.data+offset, n);
+
+                uint32_t w0 = word(Data64, group, part << 4 | n, bytes[0], bytes[1]);
+                uint32_t w1 = static_cast<uint32_t>(bytes[2]) << 24 | static_cast<uint32_t>(bytes[3]) << 16 |
+                              static_cast<uint32_t>(bytes[4]) << 8 | bytes[5];
+
+                if (!push(event.frame, w0, w1) || nbytes == 0)
+                    break;
+            }
+        }
+
+        return m_size-size;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    size_t
+    write(midibuffer& dest) const
+    // appends the packets to dest, as MIDI 1.0 events
+    // MIDI 2.0 channel voice messages are converted down: velocities, pressures and controllers
+    // to 7 bits, pitch bends to 14 bits, program changes with a bank are preceded by
+    // bank select controllers, note ons keep a non-zero velocity
+    // other packets (utility, per-note and registered controllers...) are left out
+    // returns the number of appended events
+    //---------------------------------------------------------------------------------------------
+    {
+        size_t nevents = 0;
+        byte_t sysex[255];
+        size_t nsysex = 0;
+
+        auto event = [&](vector_t frame, byte_t status, byte_t nbytes, byte_t b1, byte_t b2) {
+            if (midi_t* mt = dest.reserve(nbytes)) {
+                mt->frame = frame;
+                mt->status = status;
+                if (nbytes > 0) mt->data[0] = b1;
+                if (nbytes > 1) mt->data[1] = b2;
+                nevents++;
+            }
+        };
+
+        for (size_t p = 0; p < m_size; ++p)
+        {
+            auto frame = m_frames[p];
+            auto w0 = m_words[0][p], w1 = m_words[1][p];
+            byte_t status = (w0 >> 16) & 0xff;
+            byte_t b1 = (w0 >> 8) & 0x7f, b2 = w0 & 0x7f;
+
+            switch(w0 >> 28) {
+            case System:
+            {
+                byte_t nbytes = status == 0xf2 ? 2 : status == 0xf1 || status == 0xf3 ? 1 : 0;
+                event(frame, status, nbytes, b1, b2);
+                break;
+            }
+            case Midi1:
+            {
+                auto type = status & 0xf0;
+                event(frame, status, type == 0xc0 || type == 0xd0 ? 1 : 2, b1, b2);
+                break;
+            }
+            case Midi2:
+            {
+                byte_t channel = status & 0x0f;
+                byte_t value = static_cast<byte_t>(w1 >> 25);
+
+                switch(status & 0xf0) {
+                case 0x80: case 0xa0: case 0xb0:
+                    event(frame, status, 2, b1, value);
+                    break;
+                case 0x90:
+                    event(frame, status, 2, b1, std::max<byte_t>(value, 1));
+                    break;
+                case 0xc0:
+                    if (w0 & 1) {
+                        event(frame, 0xb0 | channel, 2, 0, (w1 >> 8) & 0x7f);
+                        event(frame, 0xb0 | channel, 2, 32, w1 & 0x7f);
+                    }
+                    event(frame, status, 1, (w1 >> 24) & 0x7f, 0);
+                    break;
+                case 0xd0:
+                    event(frame, status, 1, value, 0);
+                    break;
+                case 0xe0:
+                    event(frame, status, 2, (w1 >> 18) & 0x7f, (w1 >> 25) & 0x7f);
+                    break;
+                }
+                break;
+            }
+            case Data64:
+            {
+                byte_t part = status >> 4, n = std::min<byte_t>(status & 0x0f, 6);
+                byte_t bytes[6] = { static_cast<byte_t>(w0 >> 8), static_cast<byte_t>(w0),
+                                    static_cast<byte_t>(w1 >> 24), static_cast<byte_t>(w1 >> 16),
+                                    static_cast<byte_t>(w1 >> 8), static_cast<byte_t>(w1) };
+                if (part <= 1)
+                    nsysex = 0;
+
+                // messages that don't fit in a single event (with their F7 byte) are dropped
+                if (nsysex+n < sizeof(sysex)) {
+                    memcpy(sysex+nsysex, bytes, n);
+                    nsysex += n;
+                }
+                else nsysex = sizeof(sysex);
+
+                if ((part == 0 || part == 3) && nsysex < sizeof(sysex)) {
+                    sysex[nsysex] = 0xf7;
+                    if (dest.reserve(static_cast<byte_t>(nsysex+1), 0xf0, frame, sysex))
+                        nevents++;
+                }
+                break;
+            }
+            }
+        }
+
+        return nevents;
+    }
+
+private:
+    //---------------------------------------------------------------------------------------------
+    vector_t*
+    m_frames = nullptr;
+
+    uint32_t*
+    m_words[2] = { nullptr, nullptr };
+
+    size_t
+    m_size = 0,
+    m_capacity = 0;
+};
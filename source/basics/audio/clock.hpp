@@ -9,7 +9,8 @@ class Clock : public Node
 
     WPN_DECLARE_DEFAULT_AUDIO_INPUT(tempo, 1)
     WPN_DECLARE_AUDIO_INPUT(signature, 1)
-    WPN_DECLARE_DEFAULT_AUDIO_OUTPUT(clock_out, 1)
+    WPN_DECLARE_DEFAULT_TRIGGER_OUTPUT(clock_out, 1)
+    // one event per beat, instead of a full buffer of pulses
 
     size_t
     m_phase = 0;
@@ -25,6 +26,9 @@ public:
     {
         m_name      = "Clock";
         m_dispatch  = Dispatch::Chain;
+
+        m_tempo.set_lazy(true);
+        // tempo is read as a scalar when it isn't connected
     }
 
     //---------------------------------------------------------------------------------------------
@@ -48,26 +52,43 @@ public:
     rwrite(pool& inputs, pool& outputs, vector_t nframes) override
     //---------------------------------------------------------------------------------------------
     {
-        auto tempo  = inputs.audio[0][0];
-        auto signature = inputs.audio[1][0];
-        auto out    = outputs.audio[0][0];
+        auto out    = outputs.events[0][0];
         auto rate   = m_rate;
         auto phs    = m_phase;
 
+        if (m_tempo.constant())
+        {
+            // constant tempo: jumps from one beat to the next
+            size_t smppb = 60/m_tempo.scalar()*rate;
+
+            for (vector_t f = 0; f < nframes;) {
+                if (phs >= smppb) {
+                    phs -= smppb;
+                    out->push({ f++, 1 });
+                } else {
+                    auto n = std::min<size_t>(smppb-phs, nframes-f);
+                    phs += n;
+                    f += static_cast<vector_t>(n);
+                }
+            }
+
+            m_phase = phs;
+            return;
+        }
+
+        auto tempo  = inputs.audio[0][0];
+
         for (vector_t f = 0; f < nframes; ++f)
         {
-            auto sig = 0.25f/signature[f];
             auto secpb = 60/tempo[f];
 
             size_t smppb = secpb*rate;
 
             if (phs >= smppb) {
                 phs -= smppb;
-                out[f] = 1;
-            } else {
-                phs++;
-                out[f] = 0;
+                out->push({ f, 1 });
             }
+            else phs++;
         }
 
         m_phase = phs;
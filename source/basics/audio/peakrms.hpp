@@ -72,34 +72,14 @@ public:
         m_block_size = Graph::instance().rate()/refresh;
     }
 
-    //---------------------------------------------------------------------------------------------
-    virtual void
-    componentComplete() override
-    //---------------------------------------------------------------------------------------------
-    {
-        Node::componentComplete();
-
-        // this would be the model for multichannel expansion
-        // this has to be generalized
-        nchannels_t nchannels = 0;
-        auto connections = m_audio_in.connections();
-
-        for (auto& connection : connections)
-            nchannels = std::max(nchannels, connection->source()->nchannels());
-
-        m_audio_in.set_nchannels(nchannels);
-        m_audio_out.set_nchannels(nchannels);
-        m_peak.set_nchannels(nchannels);
-        m_rms.set_nchannels(nchannels);
-
-        m_nchannels = nchannels;
-    }
-
     //---------------------------------------------------------------------------------------------
     virtual void
     initialize(Graph::properties const& properties) override
+    // the number of channels of all Ports is inferred from audio_in's Connections
+    // (see Graph::expand), the analysis buffers keep the one they have been allocated with
     //---------------------------------------------------------------------------------------------
     {
+        m_nchannels = m_audio_in.nchannels();
         m_block_size = properties.rate/m_refresh;
         m_buffer = wpn114::allocate_buffer<audiobuffer_t>(m_nchannels, properties.vector);
 
@@ -30,6 +30,12 @@ public:
         m_name      = "Sinetest";
         m_dispatch  = Dispatch::Chain;
         // this would be the default dipsatch behaviour withinin Sinetest QML scope
+
+        m_frequency.set_lazy(true);
+        // frequency is read as a scalar when it isn't connected
+
+        m_accurate = true;
+        // scheduled frequency values are applied at their exact frame
     }
 
     //-------------------------------------------------------------------------------------------------
@@ -57,24 +63,35 @@ public:
 
     //-------------------------------------------------------------------------------------------------
     virtual void
-    rwrite(pool& inputs, pool& outputs, vector_t nframes) override
-    // the main processing function
+    rwrite(pool& inputs, pool& outputs, vector_t offset, vector_t nframes) override
+    // the main processing function, for frames [offset, offset+nframes)
     //-------------------------------------------------------------------------------------------------
     {        
         // fetch in/out buffers (first channel, as they only have one anyway)
-        auto freq  = inputs.audio[Sinetest::frequency][0];
         auto midi  = inputs.midi[Sinetest::midi_in]; // todo
-        auto out   = outputs.audio[Sinetest::audio_out][0];
+        auto out   = outputs.audio[Sinetest::audio_out][0]+offset;
 
         // put member attributes on the stack
         size_t phs = m_phs;
         sample_t const rate = m_rate;
 
-        // process each frame
-        for (vector_t f = 0; f < nframes; ++f) {
-            phs += static_cast<size_t>(freq[f]/rate * esz);
-            wpnwrap(phs, esz);
-            out[f] = m_env[phs];
+        if (m_frequency.constant()) {
+            // unconnected frequency: constant phase increment
+            auto inc = static_cast<size_t>(m_frequency.scalar()/rate * esz);
+            for (vector_t f = 0; f < nframes; ++f) {
+                phs += inc;
+                wpnwrap(phs, esz);
+                out[f] = m_env[phs];
+            }
+        }
+        else {
+            auto freq = inputs.audio[Sinetest::frequency][0]+offset;
+            // process each frame
+            for (vector_t f = 0; f < nframes; ++f) {
+                phs += static_cast<size_t>(freq[f]/rate * esz);
+                wpnwrap(phs, esz);
+                out[f] = m_env[phs];
+            }
         }
 
         // update member attribute
@@ -17,19 +17,45 @@ class VCA : public Node
 public:
 
     //-------------------------------------------------------------------------------------------------
-    VCA() { m_name = "VCA"; }
+    VCA()
+    //-------------------------------------------------------------------------------------------------
+    {
+        m_name = "VCA";
+        m_gain.set_lazy(true);
+        // gain is read as a scalar when it isn't connected
+        m_tail = 0;
+        // silent input, silent output
+
+        m_accurate = true;
+        // scheduled gain values are applied at their exact frame
+    }
 
     //-------------------------------------------------------------------------------------------------
     virtual void
-    rwrite(pool& inputs, pool& outputs, vector_t nframes) override
-    // this Node will benefits from multichannel expansion if needed
+    rwrite(pool& inputs, pool& outputs, vector_t offset, vector_t nframes) override
+    // all channels are processed within a single call, their number is inferred from
+    // the input Connections (see Graph::expand), a mono gain applies to all of them
     //-------------------------------------------------------------------------------------------------
     {
-        auto in     = inputs.audio[VCA::audio_in][0];
-        auto gain   = inputs.audio[VCA::gain][0];
-        auto out    = outputs.audio[VCA::audio_out][0];
+        auto nchannels  = std::min(m_audio_in.bound_nchannels(), m_audio_out.bound_nchannels());
+        auto ngains     = m_gain.bound_nchannels();
+
+        for (nchannels_t c = 0; c < nchannels; ++c)
+        {
+            auto in     = inputs.audio[VCA::audio_in][c]+offset;
+            auto out    = outputs.audio[VCA::audio_out][c]+offset;
+
+            if (m_gain.constant()) {
+                auto gain = m_gain.scalar();
+                for (vector_t f = 0; f < nframes; ++f)
+                     out[f] = in[f] * gain;
+                continue;
+            }
+
+            auto gain   = inputs.audio[VCA::gain][c < ngains ? c : 0]+offset;
 
-        for (vector_t f = 0; f < nframes; ++f)
-             out[f] = in[f] * gain[f];
+            for (vector_t f = 0; f < nframes; ++f)
+                 out[f] = in[f] * gain[f];
+        }
     }
 };
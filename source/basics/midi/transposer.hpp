@@ -13,7 +13,23 @@ class Transposer : public Node
 
 public:
     //---------------------------------------------------------------------------------------------
-    Transposer() { m_name = "MidiTransposer"; }
+    Transposer() { m_name = "MidiTransposer"; m_transform = true; }
+
+    //---------------------------------------------------------------------------------------------
+    virtual bool
+    rtransform(midi_t& event, pool& inputs) override
+    //---------------------------------------------------------------------------------------------
+    {
+        auto transpose = inputs.audio[0][0];
+
+        switch(event.status & 0xf0) {
+        case 0x80: case 0x90:
+            event.data[0] += static_cast<byte_t>(transpose[event.frame]);
+            break;
+        }
+
+        return true;
+    }
 
     //---------------------------------------------------------------------------------------------
     virtual void
@@ -23,18 +39,10 @@ public:
         Q_UNUSED(nframes)
 
         auto in = inputs.midi[0][0];
-        auto transpose = inputs.audio[0][0];
         auto out = outputs.midi[0][0];
 
         for (auto& event : *in)
-        {
-            switch(event.status & 0xf0) {
-            case 0x80: case 0x90:
-                event.data[0] += static_cast<byte_t>(transpose[event.frame]);
-                break;
-            }
-
-            out->push(event);
-        }
+            if (rtransform(event, inputs))
+                out->push(event);
     }
 };
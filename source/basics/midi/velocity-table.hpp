@@ -16,7 +16,7 @@ class VelocityMap : public Node
 public:
 
     //-------------------------------------------------------------------------------------------------
-    VelocityMap() { m_name = "VelocityMap"; }
+    VelocityMap() { m_name = "VelocityMap"; m_transform = true; }
 
     //-------------------------------------------------------------------------------------------------
     virtual void
@@ -41,6 +41,23 @@ public:
 
     }
 
+    //-------------------------------------------------------------------------------------------------
+    virtual bool
+    rtransform(midi_t& mt, pool& inputs) override
+    //-------------------------------------------------------------------------------------------------
+    {
+        Q_UNUSED(inputs)
+
+        switch(mt.status & 0xf0) {
+        case 0x90: {
+            mt.data[1] = m_vtable[mt.data[1]];
+            break;
+        }
+        }
+
+        return true;
+    }
+
     //-------------------------------------------------------------------------------------------------
     virtual void
     rwrite(pool& inputs, pool& outputs, vector_t nframes) override
@@ -50,16 +67,8 @@ public:
         auto midi_out = outputs.midi[0][0];
 
         for (auto& mt : *midi_in)
-        {
-            switch(mt.status & 0xf0) {
-            case 0x90: {
-                mt.data[1] = m_vtable[mt.data[1]];
-                break;
-            }
-            }
-
-            midi_out->push(mt);
-        }
+            if (rtransform(mt, inputs))
+                midi_out->push(mt);
 
     }
 
@@ -0,0 +1,152 @@
+#include <wpn114audio/executor.hpp>
+
+#ifndef _WIN32
+    #include <pthread.h>
+#endif
+
+// ------------------------------------------------------------------------------------------------
+Executor::Executor(Graph& graph, size_t nthreads) :
+    m_graph     (graph),
+    m_deques    (std::max<size_t>(nthreads, 1))
+// ------------------------------------------------------------------------------------------------
+{
+    for (size_t n = 1; n < m_deques.size(); ++n)
+         m_threads.emplace_back(&Executor::worker, this, n);
+
+    qDebug() << "[EXECUTOR] spawned" << m_threads.size() << "worker threads";
+}
+
+// ------------------------------------------------------------------------------------------------
+Executor::~Executor()
+// ------------------------------------------------------------------------------------------------
+{
+    m_exit = true;
+
+    for (size_t n = 0; n < m_threads.size(); ++n)
+         m_wakeup.post();
+
+    for (auto& thread : m_threads)
+         thread.join();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Executor::prepare(Graph::plan& plan)
+// ------------------------------------------------------------------------------------------------
+{
+    auto ntasks = plan.tasks.size();
+    auto capacity = wpn114::wsdeque::capacity(ntasks);
+
+    plan.pending.reset(new std::atomic<uint32_t>[std::max<size_t>(ntasks, 1)]);
+    plan.queues.reset(new std::atomic<uint32_t>[capacity*m_deques.size()]);
+    plan.queue_capacity = capacity;
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Executor::worker(size_t index)
+// ------------------------------------------------------------------------------------------------
+{
+#ifndef _WIN32
+    // try to get real-time scheduling, just below the audio thread
+    // this fails silently if the process isn't allowed to do so
+    sched_param param;
+    param.sched_priority = std::max(sched_get_priority_max(SCHED_FIFO)-1, 1);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+
+    for (;;)
+    {
+        m_wakeup.wait();
+
+        if (m_exit.load())
+            return;
+
+        m_busy.fetch_add(1, std::memory_order_acq_rel);
+        work(index);
+        m_busy.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Executor::work(size_t index) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    auto& deque = m_deques[index];
+    auto ndeques = m_deques.size();
+
+    while (m_remaining.load(std::memory_order_acquire))
+    {
+        uint32_t t;
+        bool found = deque.take(t);
+
+        // steal from the other threads, starting with the next one
+        for (size_t n = 1; !found && n < ndeques; ++n)
+             found = m_deques[(index+n) % ndeques].steal(t);
+
+        if (!found) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto& plan = *m_plan;
+        auto& task = plan.tasks[t];
+        m_graph.run(plan, task, m_nframes);
+
+        // release successors, the last dependency to complete pushes them
+        // onto the local deque, other threads may then steal them
+        for (uint32_t s = task.sbegin; s < task.send; ++s) {
+            auto successor = plan.successors[s];
+            if (plan.pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                deque.push(successor);
+        }
+
+        m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Executor::run(Graph::plan const& plan, vector_t nframes) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    auto ntasks = static_cast<uint32_t>(plan.tasks.size());
+
+    if (plan.pending == nullptr || plan.queue_capacity < ntasks) {
+        // plan hasn't been prepared, process it serially
+        for (auto& task : plan.tasks)
+             m_graph.run(plan, task, nframes);
+        return;
+    }
+
+    m_plan = &plan;
+    m_nframes = nframes;
+
+    for (size_t n = 0; n < m_deques.size(); ++n) {
+         m_deques[n].assign(&plan.queues[n*plan.queue_capacity], plan.queue_capacity);
+         m_deques[n].clear();
+    }
+
+    // root tasks are pushed onto the audio thread's deque
+    // workers will steal them from there
+    for (uint32_t t = 0; t < ntasks; ++t) {
+        auto ndependencies = plan.tasks[t].ndependencies;
+        plan.pending[t].store(ndependencies, std::memory_order_relaxed);
+        if (ndependencies == 0)
+            m_deques[0].push(t);
+    }
+
+    // publish the run
+    m_remaining.store(ntasks, std::memory_order_release);
+
+    for (size_t n = 0; n < m_threads.size(); ++n)
+         m_wakeup.post();
+
+    work(0);
+
+    // join: wait for workers to leave the current run
+    // before anything gets reset for the next one
+    while (m_busy.load(std::memory_order_acquire))
+           std::this_thread::yield();
+}
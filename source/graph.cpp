@@ -1,6 +1,10 @@
 #include <QtDebug>
 #include <vector>
+#include <unordered_map>
+#include <queue>
+#include <algorithm>
 #include <cmath>
+#include <QTimer>
 #include <wpn114audio/graph.hpp>
 
 Graph*
@@ -40,13 +44,14 @@ Port::Port(Node* parent, QString name, Type type, Polarity polarity,
 // C++ constructor, called from the macro-declarations
 // we immediately store a pointer in parent Node's input/output Port vector
 // ------------------------------------------------------------------------------------------------
-    m_parent      (parent),
     m_name        (name),
     m_polarity    (polarity),
     m_type        (type),
     m_nchannels   (nchannels),
-    m_value       (0),
-    m_default     (is_default)
+    m_expand      (nchannels == 0),
+    m_parent      (parent),
+    m_default     (is_default),
+    m_value       (0)
 {
     parent->register_port(*this);
 }
@@ -56,10 +61,80 @@ void
 Port::allocate(vector_t nframes)
 // ------------------------------------------------------------------------------------------------
 {
-    if   (m_type == Port::Midi_1_0)
-         m_buffer.midi = wpn114::allocate_buffer<midibuffer_t>(m_nchannels, nframes);
-    // we allocate the same buffer size (in bytes) for the midibuffer
-    else m_buffer.audio = wpn114::allocate_buffer<audiobuffer_t>(m_nchannels, nframes);
+    // Expand Ports are allocated for their inferred number of channels (see Graph::expand)
+    auto nchannels = this->nchannels();
+
+    if (m_type == Port::Control) {
+        m_buffer.control = new control_t[nchannels]();
+        m_capacity = m_bound_nchannels = nchannels;
+        return;
+    }
+
+    if (sparse()) {
+        // one event per frame at most, plans with larger blocks bring their own (see Graph::allocate)
+        m_buffer.events = new eventbuffer*[nchannels];
+        for (nchannels_t n = 0; n < nchannels; ++n) {
+             m_events.push_back(std::make_shared<eventbuffer>(nframes));
+             m_buffer.events[n] = m_events[n].get();
+        }
+        m_capacity = m_bound_nchannels = nchannels;
+        m_nframes = nframes;
+        return;
+    }
+
+    if (m_type == Port::Midi_2_0) {
+        // as many packets as a midibuffer has bytes: the events of any midibuffer fit,
+        // once converted (see umpbuffer::read), plans with larger blocks bring their own
+        m_buffer.ump = new umpbuffer*[nchannels];
+        for (nchannels_t n = 0; n < nchannels; ++n) {
+             m_packets.push_back(std::make_shared<umpbuffer>(sizeof(sample_t)*nframes));
+             m_buffer.ump[n] = m_packets[n].get();
+        }
+        m_capacity = m_bound_nchannels = nchannels;
+        m_nframes = nframes;
+        return;
+    }
+
+    if (m_type != Port::Midi_1_0)
+        return;
+
+    // we allocate the same buffer size (in bytes) for the midibuffer,
+    // plans with larger blocks bring their own (see Graph::allocate)
+    m_buffer.midi = new midibuffer*[nchannels];
+    for (nchannels_t n = 0; n < nchannels; ++n) {
+         m_midi.push_back(std::make_shared<midibuffer>(sizeof(sample_t)*nframes));
+         m_buffer.midi[n] = m_midi[n].get();
+    }
+    m_capacity = m_bound_nchannels = nchannels;
+    m_nframes = nframes;
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Port::link(Port& target, QVector<nchannels_t> const& channels)
+// ------------------------------------------------------------------------------------------------
+{
+    assert(m_type == Port::Audio && target.type() == Port::Audio);
+
+    m_link = &target;
+    m_link_channels = channels;
+    Graph::instance().update();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Port::share(Port& target, QVector<nchannels_t> const& channels)
+// ------------------------------------------------------------------------------------------------
+{
+    assert(m_type == Port::Midi_1_0 && target.type() == Port::Midi_1_0);
+
+    for (nchannels_t n = 0; n < m_midi.size() && n < channels.count(); ++n)
+        if (channels[n] < target.m_midi.size()) {
+            m_midi[n] = target.m_midi[channels[n]];
+            m_buffer.midi[n] = m_midi[n].get();
+        }
+
+    Graph::instance().update();
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -109,12 +184,18 @@ Port::assign(QVariant v)
 // ------------------------------------------------------------------------------------------------
 void
 Port::set_nchannels(nchannels_t nchannels)
-// todo: async call when graph is running
+// the running execution plan keeps the former number of channels
+// until the next one is published
+// todo: buffer reallocation when graph is running
 // ------------------------------------------------------------------------------------------------
 {
     m_nchannels = nchannels;
+    m_expand = false;
+
     for (auto& connection : m_connections)
          connection->update();
+
+    Graph::instance().update();
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -157,7 +238,151 @@ Port::set_muted(bool muted)
 // ------------------------------------------------------------------------------------------------
 {
     for (const auto& connection : m_connections)
-         connection->m_muted = muted;
+         connection->set_muted(muted);
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD bool
+Port::silent() const noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    auto nchannels = m_bound_nchannels;
+
+    if (m_type == Port::Midi_1_0) {
+        for (nchannels_t c = 0; c < nchannels; ++c)
+            if (!m_buffer.midi[c]->empty())
+                return false;
+        return true;
+    }
+
+    if (m_type == Port::Control) {
+        for (nchannels_t c = 0; c < nchannels; ++c)
+            if (m_buffer.control[c].value != 0 || m_buffer.control[c].ramp != 0)
+                return false;
+        return true;
+    }
+
+    if (sparse()) {
+        for (nchannels_t c = 0; c < nchannels; ++c)
+            if (!m_buffer.events[c]->empty())
+                return false;
+        return true;
+    }
+
+    if (m_type == Port::Midi_2_0) {
+        for (nchannels_t c = 0; c < nchannels; ++c)
+            if (!m_buffer.ump[c]->empty())
+                return false;
+        return true;
+    }
+
+    for (nchannels_t c = 0; c < nchannels; ++c)
+        if (!m_silent.test(c))
+            return false;
+
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Port::set_value(qreal value)
+// ------------------------------------------------------------------------------------------------
+{
+    m_value = value;
+    m_writes.fetch_add(1, std::memory_order_release);
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Port::set_value(qreal value, quint64 time)
+// ------------------------------------------------------------------------------------------------
+{
+    if ((m_type != Port::Audio && m_type != Port::Control) || m_polarity != Polarity::Input)
+        return;
+
+    auto schedule = m_schedule.load(std::memory_order_relaxed);
+
+    if (schedule == nullptr) {
+        schedule = new Port::schedule;
+        m_schedule.store(schedule, std::memory_order_release);
+        // scheduled values are applied in the Port's own buffer, it can't be aliased anymore
+        if (!m_connections.empty())
+            Graph::instance().update();
+    }
+
+    auto head = schedule->head.load(std::memory_order_relaxed);
+
+    if (head - schedule->tail.load(std::memory_order_acquire) == Port::schedule::capacity) {
+        qWarning() << "[PORT]" << m_name << "schedule is full, dropping value";
+        return;
+    }
+
+    schedule->events[head % Port::schedule::capacity] = { time, value };
+    schedule->head.store(head+1, std::memory_order_release);
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD bool
+Port::dequeue(uint64_t time) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    auto schedule = m_schedule.load(std::memory_order_acquire);
+
+    if (schedule == nullptr)
+        return false;
+
+    auto tail = schedule->tail.load(std::memory_order_relaxed);
+    auto head = schedule->head.load(std::memory_order_acquire);
+    bool due = false;
+
+    // values set before the scheduled ones are picked up first
+    current();
+
+    for (; tail != head && schedule->events[tail % Port::schedule::capacity].first < time; ++tail) {
+        m_current = schedule->events[tail % Port::schedule::capacity].second;
+        due = true;
+    }
+
+    schedule->tail.store(tail, std::memory_order_release);
+    return due;
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Port::apply(uint64_t time, vector_t frame, vector_t nframes) noexcept
+// block-constant Ports change their scalar, the others are offset from frame onwards,
+// on top of the Connections that have been mixed into them
+// ------------------------------------------------------------------------------------------------
+{
+    if (m_aliased || !dequeue(time+1))
+        return;
+
+    sample_t value = m_current, previous = m_scalar;
+    m_scalar = value;
+
+    if (m_type == Port::Control) {
+        for (nchannels_t c = 0; c < m_bound_nchannels; ++c)
+             m_buffer.control[c].value += value-previous;
+        return;
+    }
+
+    if (value != 0)
+        m_silent.reset();
+
+    if (m_constant) {
+        // buffer doesn't hold a single value anymore
+        m_latched = false;
+        if (m_lazy)
+            return;
+        for (nchannels_t c = 0; c < m_bound_nchannels; ++c)
+            for (vector_t f = frame; f < nframes; ++f)
+                 m_buffer.audio[c][f] = value;
+        return;
+    }
+
+    for (nchannels_t c = 0; c < m_bound_nchannels; ++c)
+        for (vector_t f = frame; f < nframes; ++f)
+             m_buffer.audio[c][f] += value-previous;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -208,6 +433,15 @@ Port::buffer() noexcept { return m_buffer.audio; }
 template<> midibuffer_t
 Port::buffer() noexcept { return m_buffer.midi; }
 
+template<> controlbuffer_t
+Port::buffer() noexcept { return m_buffer.control; }
+
+template<> eventbuffer_t
+Port::buffer() noexcept { return m_buffer.events; }
+
+template<> umpbuffer_t
+Port::buffer() noexcept { return m_buffer.ump; }
+
 // the following is used for Input/Output proxies
 // it should not be used otherwise
 
@@ -218,13 +452,25 @@ template<> void
 Port::set_buffer(midibuffer_t& buffer) noexcept { m_buffer.midi = buffer; }
 
 // ------------------------------------------------------------------------------------------------
-void
-Port::reset()
+WPN_AUDIOTHREAD void
+Port::clear(nchannels_t nchannels) noexcept
 // ------------------------------------------------------------------------------------------------
 {
-    if (m_type == Port::Midi_1_0)
-        for (nchannels_t n = 0; n < m_nchannels; ++n)
+    if (m_type == Port::Midi_1_0) {
+        m_bound_nchannels = nchannels;
+        for (nchannels_t n = 0; n < nchannels; ++n)
              m_buffer.midi[n]->clear();
+    }
+    else if (sparse()) {
+        m_bound_nchannels = nchannels;
+        for (nchannels_t n = 0; n < nchannels; ++n)
+             m_buffer.events[n]->clear();
+    }
+    else if (m_type == Port::Midi_2_0) {
+        m_bound_nchannels = nchannels;
+        for (nchannels_t n = 0; n < nchannels; ++n)
+             m_buffer.ump[n]->clear();
+    }
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -234,11 +480,27 @@ Graph::register_node(Node& node) noexcept
 // ------------------------------------------------------------------------------------------------
 {
     qDebug() << "[GRAPH] registering node:" << node.name();
-
-    QObject::connect(s_instance, &Graph::rateChanged, &node, &Node::on_rate_changed);
     m_nodes.push_back(&node);
 }
 
+// ------------------------------------------------------------------------------------------------
+void
+Graph::set_rate(sample_t rate)
+// ------------------------------------------------------------------------------------------------
+{
+    if (rate == m_properties.rate)
+        return;
+
+    m_properties.rate = rate;
+
+    for (auto& node : m_nodes)
+        if (node->m_culled)
+             node->m_rate_pending = true;
+        else node->on_rate_changed(rate);
+
+    emit rateChanged(rate);
+}
+
 // ------------------------------------------------------------------------------------------------
 void
 Port::add_connection(Connection* con)
@@ -248,6 +510,7 @@ Port::add_connection(Connection* con)
 }
 
 #include "io/external.hpp"
+#include <wpn114audio/executor.hpp>
 
 // ------------------------------------------------------------------------------------------------
 Graph::Graph()
@@ -257,13 +520,39 @@ Graph::Graph()
     m_external = new External;
 }
 
+// ------------------------------------------------------------------------------------------------
+Graph::~Graph()
+// ------------------------------------------------------------------------------------------------
+{
+    delete m_executor;
+
+    for (auto& plan : m_plans)
+         delete plan;
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::set_threads(int threads)
+// ------------------------------------------------------------------------------------------------
+{
+    if (m_complete) {
+        Graph::debug("number of threads cannot be changed once Graph is complete");
+        return;
+    }
+
+    m_threads = std::max(1, threads);
+}
+
 // ------------------------------------------------------------------------------------------------
 Connection&
 Graph::connect(Port& source, Port& dest, Routing matrix)
 // ------------------------------------------------------------------------------------------------
 {
     assert(source.polarity() == Polarity::Output && dest.polarity() == Polarity::Input);
-    assert(source.type() == dest.type());
+    // Audio and Control Ports can be connected together, as well as Trigger and Gate Ports
+    assert((source.type() == Port::Midi_1_0) == (dest.type() == Port::Midi_1_0));
+    assert((source.type() == Port::Midi_2_0) == (dest.type() == Port::Midi_2_0));
+    assert(source.sparse() == dest.sparse());
 
     m_connections.emplace_back(source, dest, matrix);
 
@@ -277,7 +566,33 @@ Graph::connect(Port& source, Port& dest, Routing matrix)
                  << ">> channel" << QString::number(matrix[n][1]);
     }
 
-    return m_connections.back();
+    auto& connection = m_connections.back();
+
+    if (m_complete) {
+        // Graph is already running, Ports have to be notified
+        // and execution plan has to be recompiled
+        source.add_connection(&connection);
+        dest.add_connection(&connection);
+    }
+
+    update();
+    return connection;
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::add_connection(Connection& con) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    m_connections.push_back(con);
+
+    if (m_complete) {
+        auto& connection = m_connections.back();
+        connection.source()->add_connection(&connection);
+        connection.dest()->add_connection(&connection);
+    }
+
+    update();
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -288,11 +603,10 @@ Graph::connect(Node& source, Node& dest, Routing matrix)
     // find matching input/output pair
     Port* s_port = nullptr, *d_port = nullptr;
 
-    if (!(s_port = source.default_port(Port::Audio, Polarity::Output)) ||
-        !(d_port = dest.default_port(Port::Audio, Polarity::Input))) {
-          s_port = source.default_port(Port::Midi_1_0, Polarity::Output);
-          d_port = dest.default_port(Port::Midi_1_0, Polarity::Input);
-    }
+    for (auto type : { Port::Audio, Port::Midi_1_0, Port::Midi_2_0, Port::Trigger, Port::Gate })
+        if ((s_port = source.default_port(type, Polarity::Output)) &&
+            (d_port = dest.default_port(type, Polarity::Input)))
+            break;
 
     return connect(*s_port, *d_port, matrix);
 }
@@ -328,18 +642,18 @@ Graph::componentComplete()
     }
 
     Graph::debug("component complete, allocating nodes i/o");
+    expand();
 
+    // at this point, all io should have been done
+    // the execution plan is compiled from the sink Nodes (see Node::sink)
     for (auto& node : m_nodes)
-    {
-        node->on_graph_complete(m_properties);
-        // at this point, all io should have been done
-        // we register all Nodes that do not have any output
-        // to the list of direct subnodes
-        // they won't be processed by the Graph otherwise
-        if (!node->m_output_ports.size() &&
-            !m_subnodes.contains(node))
-             m_subnodes.push_back(node);
-    }
+         node->on_graph_complete(m_properties);
+
+    if (m_threads > 1)
+        m_executor = new Executor(*this, m_threads);
+
+    m_complete = true;
+    compile();
 
     Graph::debug("i/o allocation complete, setting up external configuration");
     m_external->componentComplete();
@@ -348,125 +662,2482 @@ Graph::componentComplete()
 }
 
 // ------------------------------------------------------------------------------------------------
-WPN_AUDIOTHREAD vector_t
-Graph::run() noexcept
+void
+Graph::compile(Graph::plan& plan, Node& node, std::vector<Node*>& visited)
+// post-order traversal: upstream Nodes are always appended before their dest
+// a Node that is already being visited is skipped, which breaks feedback loops
+// the same way the former recursive Connection::pull used to do
 // ------------------------------------------------------------------------------------------------
 {
-    vector_t nframes = m_properties.vector;
+    if (node.m_suspended || std::find(visited.begin(), visited.end(), &node) != visited.end())
+        return;
 
-    for (auto& subnode : m_subnodes)
-        subnode->process(nframes);
+    visited.push_back(&node);
 
-    for (auto& node : m_nodes)
-        node->set_processed(false);
+    // Connections from suspended Nodes are left out, as if they were inactive
+    auto live = [](Connection* connection) {
+        return connection->active() && !connection->source()->parent_node().m_suspended;
+    };
 
-    return nframes;
-}
+    for (auto& port : node.m_input_ports)
+        for (auto& connection : port->connections())
+            if (live(connection))
+                compile(plan, connection->source()->parent_node(), visited);
 
-// ------------------------------------------------------------------------------------------------
-WPN_AUDIOTHREAD vector_t
-Graph::run(Node& target) noexcept
-// the main processing function
-// Graph will process itself from target Node and upstream recursively
-// ------------------------------------------------------------------------------------------------
-{
-    // take a little amount of time to process asynchronous graph update requests (TODO)
-    WPN_TODO
+    for (auto& dependency : node.m_dependencies)
+         compile(plan, *dependency, visited);
 
-    // process target, return outputs            
-    vector_t nframes = m_properties.vector;
-    target.process(nframes);
+    std::unordered_map<Connection*, bool> reduced;
 
-    for (auto& node : m_nodes)
-         node->set_processed(false);
+    if (node.m_dispatch == Dispatch::Values::Parallel)
+        reduced = reduce(plan, node);
 
-    return nframes;
-}
+    Graph::task task;
+    task.begin = static_cast<uint32_t>(plan.operations.size());
 
-#include <wpn114audio/spatial.hpp>
+    for (auto& port : node.m_input_ports)
+    {
+        bool connected = std::any_of(port->connections().begin(), port->connections().end(), live);
+
+        Graph::operation fill;
+        fill.type = port->type() == Port::Audio && !connected ?
+                    Graph::operation::Latch : Graph::operation::Fill;
+        fill.port = port;
+        fill.nchannels = std::min(port->nchannels(), port->capacity());
+        plan.operations.push_back(fill);
+
+        for (auto& connection : port->connections()) {
+            auto reduction = reduced.find(connection);
+
+            if (!live(connection) || (reduction != reduced.end() && !reduction->second))
+                continue;
+
+            Graph::operation mix;
+            mix.type = Graph::operation::Mix;
+            mix.connection = connection;
+            mix.reduced = reduction != reduced.end();
+
+            auto route = plan.routes.find(connection);
+            if (route != plan.routes.end()) {
+                mix.cables = plan.cables.data() + route->second.begin;
+                mix.nchannels = route->second.ncables;
+            }
 
-// ------------------------------------------------------------------------------------------------
-Node::~Node()
-// ------------------------------------------------------------------------------------------------
-{
-    if (m_spatial)
-        delete m_spatial;
+            mix.variant = mix.reduced ? wpn114::mix::Accumulate :
+                          wpn114::mix::select(connection->mul(), connection->add());
+            mix.kernel = wpn114::mix::get(mix.variant);
+            plan.operations.push_back(mix);
+            plan.nedges++;
+        }
+    }
 
-    Graph::instance().unregister_node(*this);
+    Graph::operation process;
+    process.type = Graph::operation::Process;
+    process.node = &node;
+    plan.operations.push_back(process);
+    plan.nnodes++;
+
+    task.end = static_cast<uint32_t>(plan.operations.size());
+    plan.tasks.push_back(task);
 }
 
 // ------------------------------------------------------------------------------------------------
-Spatial*
-Node::spatial()
-// if qml requests access to spatial, we have to create it
+std::unordered_map<Connection*, bool>
+Graph::reduce(Graph::plan& plan, Node& node)
+// the subnodes of a Dispatch::Parallel Node are processed concurrently,
+// their outputs are then summed by a tree of tasks, instead of being mixed one after the other
+// by the parent's task: output n is accumulated into output n-step, step doubling at each level
+// - only the subnodes that have already been compiled, with a single active identity
+//   Connection (unity gain, zero add, implicit routing, not muted) going out of them, and
+//   no persistent or linked Ports, are part of the reduction: their outputs can be modified
+// - each output is scaled by its own Connection's gain when it is first reduced,
+//   so that gain (and mute) changes apply right away, before the plan is recompiled
+// - the parent only mixes the first output, which ends up holding the sum of all of them,
+//   without applying its Connection's gain a second time
 // ------------------------------------------------------------------------------------------------
 {
-    if (!m_spatial) {
-        qDebug() << m_name << "creating spatial attributes";
+    std::unordered_map<Connection*, bool> reduced;
+    std::unordered_map<Port*, bool> targets;
+
+    for (auto& n : m_nodes)
+        for (auto& ports : { &n->m_input_ports, &n->m_output_ports })
+            for (auto& port : *ports)
+                if (port->m_link)
+                    targets[port->m_link] = true;
+
+    auto compiled = [&](Node& source) {
+        return std::any_of(plan.tasks.rbegin(), plan.tasks.rend(), [&](Graph::task const& task) {
+            auto& operation = plan.operations[task.end-1];
+            return operation.type == Graph::operation::Process && operation.node == &source;
+        });
+    };
+
+    auto eligible = [&](Connection* connection) {
+        auto source = connection->source();
+        auto& parent = source->parent_node();
+
+        if (!connection->active() || connection->muted() || parent.m_suspended ||
+            source->type() != Port::Audio || !connection->m_routing.null() ||
+            wpn114::mix::select(connection->mul(), connection->add()) != wpn114::mix::Accumulate ||
+            std::none_of(node.m_subnodes.begin(), node.m_subnodes.end(),
+                         [&](Node* subnode) { return &subnode->chainout() == &parent; }))
+            return false;
+
+        size_t nconnections = 0;
+
+        for (auto& ports : { &parent.m_input_ports, &parent.m_output_ports })
+            for (auto& port : *ports)
+                if (port->persistent() || port->m_link || targets.count(port))
+                    return false;
+
+        for (auto& port : parent.m_output_ports)
+            for (auto& c : port->connections())
+                if (c->active())
+                    nconnections++;
+
+        return nconnections == 1 && compiled(parent);
+    };
+
+    for (auto& port : node.m_input_ports)
+    {
+        if (port->type() != Port::Audio)
+            continue;
+
+        std::vector<Connection*> connections;
+
+        for (auto& connection : port->connections())
+        {
+            if (!eligible(connection))
+                continue;
+
+            // all outputs have to cover the same channels
+            auto route = plan.routes.find(connection);
+            if (route == plan.routes.end())
+                continue;
+
+            if (!connections.empty()) {
+                auto front = connections.front();
+                if (plan.routes[front].ncables != route->second.ncables ||
+                    front->source()->nchannels() != connection->source()->nchannels())
+                    continue;
+            }
 
-        m_spatial = new Spatial(default_port(Polarity::Output)->nchannels());
-        // we make an implicit connection
-        m_subnodes.push_front(m_spatial);
+            connections.push_back(connection);
+        }
+
+        if (connections.size() < 2)
+            continue;
+
+        std::vector<bool> scaled(connections.size(), false);
+
+        for (size_t step = 1; step < connections.size(); step *= 2)
+            for (size_t n = 0; n+step < connections.size(); n += step*2)
+            {
+                Graph::task task;
+                task.begin = static_cast<uint32_t>(plan.operations.size());
+
+                Graph::operation reduce;
+                reduce.type = Graph::operation::Reduce;
+                reduce.connection = connections[n+step];
+                reduce.target = connections[n]->source();
+                reduce.nchannels = std::min(connections[n]->source()->nchannels(),
+                                            connections[n]->source()->capacity());
+                reduce.variant = wpn114::mix::Accumulate;
+                reduce.kernel = wpn114::mix::get(reduce.variant);
+
+                if (!scaled[n]) {
+                    reduce.scale = connections[n];
+                    scaled[n] = true;
+                }
+
+                plan.operations.push_back(reduce);
+                plan.nedges++;
+
+                task.end = static_cast<uint32_t>(plan.operations.size());
+                plan.tasks.push_back(task);
+            }
+
+        reduced[connections.front()] = true;
+
+        for (auto c = connections.begin()+1; c != connections.end(); ++c)
+             reduced[*c] = false;
     }
 
-    return m_spatial;
+    return reduced;
 }
 
 // ------------------------------------------------------------------------------------------------
-void
-Node::allocate_pools()
+static Node*
+owner(Graph::plan const& plan, Graph::task const& task)
+// the Node processed by task, or the one whose output it accumulates into (see Graph::reduce)
 // ------------------------------------------------------------------------------------------------
 {
-    for (auto& port : m_input_ports)
-        if (port->type() == Port::Audio)
-             m_input_pool.audio.push_back(port->buffer<audiobuffer_t>());
-        else m_input_pool.midi.push_back(port->buffer<midibuffer_t>());
+    auto& operation = plan.operations[task.end-1];
 
-    for (auto& port : m_output_ports)
-        if (port->type() == Port::Audio)
-             m_output_pool.audio.push_back(port->buffer<audiobuffer_t>());
-        else m_output_pool.midi.push_back(port->buffer<midibuffer_t>());
-}
+    if (operation.type == Graph::operation::Reduce)
+        return &operation.target->parent_node();
 
-// ------------------------------------------------------------------------------------------------
-// CONNECTION
-//-------------------------------------------------------------------------------------------------
-Connection::Connection(Port& source, Port& dest, Routing matrix) :
-    m_source   (&source),
-    m_dest     (&dest),
-    m_routing  (matrix)
-{
-    componentComplete();
+    return operation.node;
 }
 
 // ------------------------------------------------------------------------------------------------
 void
-Connection::setTarget(const QQmlProperty& target)
-// qml property binding, e. g.:
-// Connection on 'Port' { level: db(-12); routing: [0, 1] }
+Graph::fuse(Graph::plan& plan)
+// a Node whose only live Connection comes from the Node processed by the previous task,
+// and feeds nothing else, is merged into that task, with its source:
+// - Audio: if both process segments (see Node::m_accurate), the chain's Nodes and Connections
+//   are then processed by tiles of a few frames (see Graph::tile), its intermediate buffers
+//   remain in cache, instead of going through memory once per Node and Connection
+//   fused Nodes are always processed, even when their inputs are silent (see Node::idle),
+//   and sample-accurate plans aren't fused, their Nodes' blocks are split instead
+// - Midi: if both are filters (see Node::rtransform), the chain's events are processed
+//   in a single pass (see Graph::transform), only its last Node's output is written,
+//   and its Connections are no longer pulled, events only go through the unmuted ones
+//   (muted Connections are left out of the chains they would start)
+// Nodes with persistent or linked Ports are left out
 // ------------------------------------------------------------------------------------------------
 {
-    auto port = target.read().value<Port*>();
+    std::unordered_map<Port*, bool> targets;
 
-    switch(port->polarity()) {
-        case Polarity::Output: m_source = port; break;
-        case Polarity::Input: m_dest = port;
+    for (auto& node : m_nodes)
+        for (auto& ports : { &node->m_input_ports, &node->m_output_ports })
+            for (auto& port : *ports)
+                if (port->m_link)
+                    targets[port->m_link] = true;
+
+    auto simple = [&](Node& node) {
+        for (auto& ports : { &node.m_input_ports, &node.m_output_ports })
+            for (auto& port : *ports)
+                if (port->persistent() || port->m_link || targets.count(port))
+                    return false;
+        return true;
+    };
+
+    // a single Midi input and output
+    auto filter = [](Node& node) {
+        auto midi = [](std::vector<Port*> const& ports) {
+            return std::count_if(ports.begin(), ports.end(),
+                   [](Port* port) { return port->type() == Port::Midi_1_0; });
+        };
+        return node.m_transform && midi(node.m_input_ports) == 1 && midi(node.m_output_ports) == 1;
+    };
+
+    std::vector<Graph::operation> operations;
+    std::vector<Graph::task> tasks;
+    size_t nfused = 0, nfiltered = 0;
+
+    for (auto& task : plan.tasks)
+    {
+        auto& process = plan.operations[task.end-1];
+        Graph::operation const* chain = nullptr;
+        size_t nmixes = 0;
+
+        for (auto o = task.begin; o < task.end; ++o)
+            if (plan.operations[o].type == Graph::operation::Mix) {
+                chain = &plan.operations[o];
+                nmixes++;
+            }
+
+        Node* previous = nullptr;
+
+        if (!tasks.empty() && operations[tasks.back().end-1].type == Graph::operation::Process)
+            previous = operations[tasks.back().end-1].node;
+
+        auto type = Graph::operation::Fill;
+
+        if (previous && process.type == Graph::operation::Process && nmixes == 1 &&
+            &chain->connection->source()->parent_node() == previous &&
+            simple(*previous) && simple(*process.node))
+        {
+            auto source = chain->connection->source(), dest = chain->connection->dest();
+            size_t nconnections = 0;
+
+            for (auto& port : previous->m_output_ports)
+                for (auto& connection : port->connections())
+                    if (connection->active())
+                        nconnections++;
+
+            if (nconnections == 1 && source->type() == Port::Audio && dest->type() == Port::Audio &&
+                previous->m_accurate && process.node->m_accurate && !plan.accurate)
+                type = Graph::operation::Fuse;
+            else if (nconnections == 1 && source->type() == Port::Midi_1_0 &&
+                     filter(*previous) && filter(*process.node) && chain->nchannels == 1 &&
+                     chain->cables[0][0] == 0 && chain->cables[0][1] == 0 &&
+                     !chain->connection->muted())
+                type = Graph::operation::Transform;
+        }
+
+        auto tile = operations.end();
+
+        if (type != Graph::operation::Fill) {
+            tile = std::find_if(operations.begin()+tasks.back().begin, operations.end(),
+                   [](Graph::operation const& o) {
+                       return o.type == Graph::operation::Fuse || o.type == Graph::operation::Transform;
+                   });
+            if (tile != operations.end() && tile->type != type)
+                // previous Nodes are already fused the other way
+                type = Graph::operation::Fill;
+        }
+
+        if (type == Graph::operation::Fill) {
+            Graph::task copy;
+            copy.begin = static_cast<uint32_t>(operations.size());
+            operations.insert(operations.end(), plan.operations.begin()+task.begin,
+                              plan.operations.begin()+task.end);
+            copy.end = static_cast<uint32_t>(operations.size());
+            tasks.push_back(copy);
+            continue;
+        }
+
+        auto& fused = tasks.back();
+        auto begin = operations.begin()+fused.begin;
+
+        // [inputs of the chain's Nodes] [Fuse] [Process] [Mix] [Process]...
+        // [inputs of the chain's Nodes] [Transform] [Process] [Mix] [Process]...
+        std::vector<Graph::operation> inputs, region;
+
+        if (tile != operations.end()) {
+            inputs.assign(begin, tile);
+            region.assign(tile+1, operations.end());
+        }
+        else {
+            inputs.assign(begin, operations.end()-1);
+            region.push_back(operations.back());
+        }
+
+        for (auto o = task.begin; o < task.end-1; ++o)
+            if (&plan.operations[o] != chain)
+                inputs.push_back(plan.operations[o]);
+
+        region.push_back(*chain);
+        region.push_back(process);
+
+        Graph::operation operation;
+        operation.type = type;
+        operation.length = static_cast<uint32_t>(region.size());
+
+        operations.resize(fused.begin);
+        operations.insert(operations.end(), inputs.begin(), inputs.end());
+        operations.push_back(operation);
+        operations.insert(operations.end(), region.begin(), region.end());
+        fused.end = static_cast<uint32_t>(operations.size());
+
+        if (type == Graph::operation::Fuse)
+             nfused++;
+        else nfiltered++;
     }
 
-    componentComplete();
-    Graph::instance().add_connection(*this);
+    plan.operations = std::move(operations);
+    plan.tasks = std::move(tasks);
+
+    if (nfused || nfiltered)
+        qDebug() << "[GRAPH]" << nfused << "nodes fused into their upstream chain,"
+                 << nfiltered << "into their upstream midi filter chain";
 }
 
 // ------------------------------------------------------------------------------------------------
 void
-Connection::componentComplete()
+Graph::pipeline(Graph::plan& plan)
+// the plan's tasks are cut into consecutive stages, balanced by number of Nodes
+// at each run, stage n processes the block stage 0 has processed n runs before:
+// stages don't depend on each other within a run, and are processed concurrently
+// - i/o input Nodes are moved to the first stage, and output Nodes to the last one,
+//   so that the plan's latency is the same for all of its external paths
+// - Audio Connections between stages read their source from an earlier run (see Graph::ring)
+// - Midi Connections, feedback Connections and linked Ports can't span two stages,
+//   plans are only cut where none of them does (a plan may end up with fewer stages)
+// ------------------------------------------------------------------------------------------------
 {
-    m_nchannels = std::min(m_source->nchannels(), m_dest->nchannels());
+    auto ntasks = static_cast<uint32_t>(plan.tasks.size());
+    auto nstages = m_executor ? std::min<size_t>(m_stages, m_executor->nthreads()) : 1;
+
+    plan.nstages = 1;
+    plan.stages.clear();
+
+    if (nstages < 2 || ntasks < 2)
+        return;
+
+    auto persistent = [](std::vector<Port*> const& ports) {
+        return std::any_of(ports.begin(), ports.end(), [](Port* port) { return port->persistent(); });
+    };
+
+    std::vector<Graph::task> tasks;
+
+    auto node = [&](Graph::task const& task) { return owner(plan, task); };
+    auto input = [&](Graph::task const& task) {
+        return node(task)->m_input_ports.empty() && persistent(node(task)->m_output_ports);
+    };
+    // Nodes other ones depend on (e.g. Spatial) are left in place
+    std::unordered_map<Node*, bool> dependencies;
+
+    for (auto& operation : plan.operations)
+        if (operation.type == Graph::operation::Process)
+            for (auto& dependency : operation.node->m_dependencies)
+                dependencies[dependency] = true;
+
+    auto output = [&](Graph::task const& task) {
+        return node(task)->m_output_ports.empty() && persistent(node(task)->m_input_ports) &&
+               !dependencies.count(node(task));
+    };
+
+    // these have no dependencies (resp. no successors), the plan remains topologically sorted
+    for (auto& task : plan.tasks)
+        if (input(task))
+            tasks.push_back(task);
+
+    auto ninputs = static_cast<uint32_t>(tasks.size());
+
+    for (auto& task : plan.tasks)
+        if (!input(task) && !output(task))
+            tasks.push_back(task);
+
+    auto noutputs = ntasks-static_cast<uint32_t>(tasks.size());
+
+    for (auto& task : plan.tasks)
+        if (output(task) && !input(task))
+            tasks.push_back(task);
+
+    std::vector<Graph::operation> operations;
+    std::unordered_map<Node*, uint32_t> indexes, processes;
+
+    for (uint32_t t = 0; t < ntasks; ++t)
+    {
+        auto& task = tasks[t];
+        auto begin = static_cast<uint32_t>(operations.size());
+        indexes[node(task)] = t;
+
+        // fused tasks process several Nodes (see Graph::fuse)
+        for (auto o = task.begin; o < task.end; ++o)
+            if (plan.operations[o].type == Graph::operation::Process)
+                indexes[plan.operations[o].node] = processes[plan.operations[o].node] = t;
+
+        operations.insert(operations.end(), plan.operations.begin()+task.begin,
+                          plan.operations.begin()+task.end);
+        task.begin = begin;
+        task.end = static_cast<uint32_t>(operations.size());
+    }
+
+    plan.tasks = std::move(tasks);
+    plan.operations = std::move(operations);
+
+    std::unordered_map<Port*, bool> targets;
+
+    for (auto& task : plan.tasks)
+        for (auto& ports : { &node(task)->m_input_ports, &node(task)->m_output_ports })
+            for (auto& port : *ports)
+                if (port->m_link)
+                    targets[port->m_link] = true;
+
+    // cut n separates tasks [0, n) from tasks [n, ntasks)
+    std::vector<int> spans(ntasks+1, 0);
+
+    auto forbid = [&](uint32_t lhs, uint32_t rhs) {
+        if (lhs == rhs)
+            return;
+        spans[std::min(lhs, rhs)+1]++;
+        spans[std::max(lhs, rhs)+1]--;
+    };
+
+    for (uint32_t t = 0; t < ntasks; ++t)
+    {
+        auto& task = plan.tasks[t];
+
+        for (auto o = task.begin; o < task.end; ++o)
+        {
+            auto& operation = plan.operations[o];
+
+            if (operation.type == Graph::operation::Reduce) {
+                // reductions are processed along with the Nodes they sum
+                forbid(processes[&operation.connection->source()->parent_node()], t);
+                forbid(processes[&operation.target->parent_node()], t);
+                continue;
+            }
+
+            if (operation.type == Graph::operation::Process) {
+                // dependencies are read directly, from the same run
+                for (auto& dependency : operation.node->m_dependencies) {
+                    auto index = indexes.find(dependency);
+                    if (index != indexes.end())
+                        forbid(index->second, t);
+                }
+                continue;
+            }
+
+            if (operation.type != Graph::operation::Mix)
+                continue;
+
+            auto source = operation.connection->source();
+            auto index = indexes.find(&source->parent_node());
+
+            if (index == indexes.end())
+                continue;
+
+            if (source->type() != Port::Audio || index->second > t ||
+                source->m_link || targets.count(source))
+                forbid(index->second, t);
+        }
+
+        for (auto& ports : { &node(task)->m_input_ports, &node(task)->m_output_ports })
+            for (auto& port : *ports)
+                if (port->m_link) {
+                    auto target = indexes.find(&port->m_link->parent_node());
+                    if (target != indexes.end())
+                        forbid(target->second, t);
+                }
+    }
+
+    std::vector<bool> valid(ntasks+1, false);
+
+    // i/o tasks can't be separated: cuts lie after the last input task, before the first output one
+    for (uint32_t n = 1, span = spans[0]; n < ntasks; ++n) {
+        span += spans[n];
+        valid[n] = span == 0 && n >= ninputs && n <= ntasks-noutputs;
+    }
+
+    // picks the valid cut closest to each ideal one
+    std::vector<uint32_t> cuts;
+
+    for (size_t s = 1; s < nstages; ++s)
+    {
+        auto ideal = static_cast<int64_t>((ntasks*s+nstages/2)/nstages);
+        auto previous = cuts.empty() ? 0 : static_cast<int64_t>(cuts.back());
+        int64_t best = -1;
+
+        for (int64_t n = previous+1; n < ntasks; ++n)
+            if (valid[n] && (best < 0 || std::abs(n-ideal) < std::abs(best-ideal)))
+                best = n;
+
+        if (best > 0)
+            cuts.push_back(static_cast<uint32_t>(best));
+    }
+
+    if (cuts.empty())
+        return;
+
+    plan.nstages = cuts.size()+1;
+    plan.stages.resize(ntasks);
+
+    for (uint32_t t = 0, s = 0; t < ntasks; ++t) {
+        if (s < cuts.size() && t == cuts[s])
+            s++;
+        plan.stages[t] = s;
+    }
+
+    for (uint32_t t = 0; t < ntasks; ++t)
+    {
+        auto& task = plan.tasks[t];
+
+        for (auto o = task.begin; o < task.end; ++o)
+        {
+            auto& operation = plan.operations[o];
+            if (operation.type != Graph::operation::Mix)
+                continue;
+
+            auto index = indexes.find(&operation.connection->source()->parent_node());
+            if (index != indexes.end())
+                operation.delay = static_cast<uint8_t>(plan.stages[t]-plan.stages[index->second]);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::audible(Node& node, std::vector<Node*>& visited)
+// ------------------------------------------------------------------------------------------------
+{
+    if (std::find(visited.begin(), visited.end(), &node) != visited.end())
+        return;
+
+    visited.push_back(&node);
+
+    for (auto& port : node.m_input_ports)
+        for (auto& connection : port->connections())
+            if (connection->active() && !connection->muted())
+                audible(connection->source()->parent_node(), visited);
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::routes(Graph::plan& plan)
+// Connections of all registered Nodes are compiled, including the ones
+// that are processed outside of the plan's operations (see Node::process)
+// ------------------------------------------------------------------------------------------------
+{
+    auto nchannels = [](Port* port) {
+        return std::min(port->nchannels(), port->capacity());
+    };
+
+    for (auto& node : m_nodes)
+        for (auto& port : node->m_input_ports)
+            for (auto& connection : port->connections())
+            {
+                if (!connection->active())
+                    continue;
+
+                auto snchannels = nchannels(connection->source());
+                auto dnchannels = nchannels(connection->dest());
+
+                Graph::route route;
+                route.begin = static_cast<uint32_t>(plan.cables.size());
+
+                if (connection->m_routing.null())
+                    for (nchannels_t c = 0; c < std::min({connection->m_nchannels,
+                                                          snchannels, dnchannels}); ++c)
+                         plan.cables.push_back({ c, c });
+                else
+                    for (auto& cable : connection->m_routing.cables())
+                        if (cable[0] < snchannels && cable[1] < dnchannels)
+                            plan.cables.push_back(cable);
+
+                route.ncables = static_cast<nchannels_t>(plan.cables.size()-route.begin);
+                plan.routes[connection] = route;
+            }
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::expand()
+// Audio/Control Ports declared without any channel (see Port::set_nchannels) get:
+// - inputs: the number of channels of their widest active Connection (or its routing)
+// - outputs: the number of channels of their Node's widest Audio/Control input,
+//   which is also the number of lanes of a Dispatch::Expand Node (see Node::expand)
+// counts only grow while they propagate downstream, until nothing changes anymore:
+// they are inferred from scratch at each compilation, feedback loops included
+// ------------------------------------------------------------------------------------------------
+// Dispatch::Split/Merge Nodes' subnodes are given consecutive channels, as many as
+// their (inferred) number of channels, at least one
+// ------------------------------------------------------------------------------------------------
+{
+    std::unordered_map<Port*, nchannels_t> counts;
+
+    auto expandable = [](Port* port) {
+        return port->m_expand && (port->type() == Port::Audio || port->type() == Port::Control);
+    };
+
+    for (auto& node : m_nodes)
+        for (auto& ports : { &node->m_input_ports, &node->m_output_ports })
+            for (auto& port : *ports)
+                if (expandable(port))
+                    counts[port] = 0;
+
+    auto nchannels = [&](Port* port) {
+        auto count = counts.find(port);
+        return count == counts.end() ? port->nchannels() : count->second;
+    };
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+
+        for (auto& node : m_nodes)
+        {
+            bool split = node->m_dispatch == Dispatch::Values::Split;
+
+            if (!split && node->m_dispatch != Dispatch::Values::Merge)
+                continue;
+
+            nchannels_t offset = 0;
+
+            for (auto& subnode : node->m_subnodes)
+            {
+                auto source = split ? node->default_port(Port::Audio, Polarity::Output) :
+                              subnode->chainout().default_port(Port::Audio, Polarity::Output);
+                auto dest = split ? subnode->default_port(Port::Audio, Polarity::Input) :
+                            node->default_port(Port::Audio, Polarity::Input);
+                auto connection = source && dest ? get_connection(*source, *dest) : nullptr;
+
+                if (connection == nullptr)
+                    continue;
+
+                Routing routing;
+                auto width = std::max<nchannels_t>(nchannels(split ? dest : source), 1);
+
+                for (nchannels_t c = 0; c < width; ++c, ++offset)
+                    split ? routing.append(offset, c) : routing.append(c, offset);
+
+                if (routing.cables() != connection->m_routing.cables()) {
+                    connection->m_routing = routing;
+                    changed = true;
+                }
+            }
+        }
+
+        auto grow = [&](Port* port, nchannels_t n) {
+            auto& count = counts[port];
+            if (n > count) {
+                count = n;
+                changed = true;
+            }
+        };
+
+        for (auto& node : m_nodes)
+        {
+            nchannels_t widest = 0;
+
+            for (auto& port : node->m_input_ports)
+            {
+                if (port->type() != Port::Audio && port->type() != Port::Control)
+                    continue;
+
+                if (expandable(port))
+                    for (auto& connection : port->connections())
+                    {
+                        if (!connection->active())
+                            continue;
+
+                        if (connection->m_routing.null())
+                            grow(port, nchannels(connection->source()));
+                        else for (auto& cable : connection->m_routing.cables())
+                            grow(port, static_cast<nchannels_t>(std::min(cable[1]+1, 255)));
+                    }
+
+                widest = std::max(widest, nchannels(port));
+            }
+
+            for (auto& port : node->m_output_ports)
+                if (expandable(port))
+                    grow(port, widest);
+        }
+    }
+
+    for (auto& count : counts)
+    {
+        auto port = count.first;
+
+        if (port->m_inferred == count.second)
+            continue;
+
+        port->m_inferred = count.second;
+
+        for (auto& connection : port->connections())
+             connection->update();
+    }
+
+    for (auto& node : m_nodes)
+        if (node->m_dispatch == Dispatch::Values::Expand && !node->m_expandable)
+            qDebug() << "[GRAPH]" << node->name() << "isn't expandable, processed as Upwards";
+}
+
+// ------------------------------------------------------------------------------------------------
+static void
+gather_buffers(Port& port, std::unordered_map<Port*, Graph::binding const*>& bindings,
+               std::vector<void*>& buffers)
+// Audio buffers are looked up in the plan's own arena,
+// Ports may still be bound to the previous one
+// ------------------------------------------------------------------------------------------------
+{
+    if (port.type() == Port::Audio) {
+        auto binding = bindings.find(&port);
+        if (binding != bindings.end() && binding->second->table)
+            for (nchannels_t c = 0; c < binding->second->nchannels; ++c)
+                 buffers.push_back(binding->second->table[c]);
+    }
+    else if (port.type() == Port::Control) {
+        if (auto buffer = port.buffer<controlbuffer_t>())
+            for (nchannels_t c = 0; c < std::min(port.nchannels(), port.capacity()); ++c)
+                 buffers.push_back(&buffer[c]);
+    }
+    else if (port.sparse()) {
+        // channel table entries: their buffers may be rebound (see Graph::bind)
+        if (auto buffer = port.buffer<eventbuffer_t>())
+            for (nchannels_t c = 0; c < std::min(port.nchannels(), port.capacity()); ++c)
+                 buffers.push_back(&buffer[c]);
+    }
+    else if (port.type() == Port::Midi_2_0) {
+        // same as sparse Ports
+        if (auto buffer = port.buffer<umpbuffer_t>())
+            for (nchannels_t c = 0; c < std::min(port.nchannels(), port.capacity()); ++c)
+                 buffers.push_back(&buffer[c]);
+    }
+    else if (port.type() == Port::Midi_1_0) {
+        // their buffers may be rebound too, shared channels (see Port::share) have the same owner
+        auto& midi = port.midibuffers();
+        for (nchannels_t c = 0; c < std::min<size_t>(port.nchannels(), midi.size()); ++c)
+             buffers.push_back(midi[c].get());
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::schedule(Graph::plan& plan)
+// a task depends on:
+// - the tasks processing its Connections' source Nodes
+// - for feedback Connections (source processed after dest in the plan),
+//   the source depends on dest instead, so that dest still reads the previous block
+// - the previous task writing into one of its buffers, if any (e.g. aliased proxy buffers)
+// all dependencies therefore go from a lower to a higher task index,
+// which guarantees the exact same output as the serial plan
+// ------------------------------------------------------------------------------------------------
+{
+    if (plan.nstages > 1)
+    {
+        // pipelined plan: stages process different blocks, they don't depend on each other
+        std::vector<Graph::task> stages(plan.nstages);
+
+        for (auto& stage : stages)
+             stage.begin = UINT32_MAX;
+
+        for (size_t t = 0; t < plan.tasks.size(); ++t) {
+            auto& stage = stages[plan.stages[t]];
+            stage.begin = std::min(stage.begin, plan.tasks[t].begin);
+            stage.end = std::max(stage.end, plan.tasks[t].end);
+        }
+
+        plan.tasks = std::move(stages);
+        plan.successors.clear();
+        return;
+    }
+
+    auto ntasks = static_cast<uint32_t>(plan.tasks.size());
+
+    std::unordered_map<Node*, uint32_t> indexes;
+    std::unordered_map<void*, uint32_t> writers;
+    std::vector<std::vector<uint32_t>> edges(ntasks);
+    std::vector<void*> buffers;
+    std::unordered_map<Port*, Graph::binding const*> bindings;
+
+    for (auto& binding : plan.bindings)
+         bindings[binding.port] = &binding;
+
+    for (uint32_t t = 0; t < ntasks; ++t) {
+        indexes[owner(plan, plan.tasks[t])] = t;
+        for (auto o = plan.tasks[t].begin; o < plan.tasks[t].end; ++o)
+            if (plan.operations[o].type == Graph::operation::Process)
+                indexes[plan.operations[o].node] = t;
+    }
+
+    for (uint32_t t = 0; t < ntasks; ++t)
+    {
+        auto& task = plan.tasks[t];
+        buffers.clear();
+
+        for (uint32_t o = task.begin; o < task.end; ++o)
+        {
+            auto& operation = plan.operations[o];
+            switch(operation.type)
+            {
+            case Graph::operation::Fill:
+            case Graph::operation::Latch:
+                gather_buffers(*operation.port, bindings, buffers);
+                break;
+
+            case Graph::operation::Reduce:
+                gather_buffers(*operation.target, bindings, buffers);
+                [[fallthrough]];
+            case Graph::operation::Mix:
+            case Graph::operation::Alias:
+            {
+                auto source = indexes[&operation.connection->source()->parent_node()];
+                if (source < t)
+                    edges[source].push_back(t);
+                else if (source > t)
+                    edges[t].push_back(source);
+                break;
+            }
+            case Graph::operation::Process:
+                for (auto& port : operation.node->m_output_ports)
+                     gather_buffers(*port, bindings, buffers);
+                for (auto& dependency : operation.node->m_dependencies) {
+                    auto source = indexes.find(dependency);
+                    if (source != indexes.end() && source->second < t)
+                        edges[source->second].push_back(t);
+                }
+                break;
+
+            case Graph::operation::Clear:
+                // output buffers are gathered along with the Process operation
+                break;
+
+            case Graph::operation::Fuse:
+            case Graph::operation::Transform:
+                // the fused region's operations follow, they're scheduled one by one
+                break;
+            }
+        }
+
+        for (auto& buffer : buffers) {
+            auto writer = writers.find(buffer);
+            if (writer != writers.end() && writer->second != t)
+                edges[writer->second].push_back(t);
+            writers[buffer] = t;
+        }
+    }
+
+    plan.successors.clear();
+
+    for (uint32_t t = 0; t < ntasks; ++t)
+    {
+        auto& successors = edges[t];
+        std::sort(successors.begin(), successors.end());
+        successors.erase(std::unique(successors.begin(), successors.end()), successors.end());
+
+        plan.tasks[t].sbegin = static_cast<uint32_t>(plan.successors.size());
+
+        for (auto& successor : successors) {
+            plan.successors.push_back(successor);
+            plan.tasks[successor].ndependencies++;
+        }
+
+        plan.tasks[t].send = static_cast<uint32_t>(plan.successors.size());
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::update()
+// ------------------------------------------------------------------------------------------------
+{
+    if (!m_complete || m_update)
+        return;
+
+    m_update = true;
+    QMetaObject::invokeMethod(this, "compile", Qt::QueuedConnection);
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::drain(uint64_t since)
+// ------------------------------------------------------------------------------------------------
+{
+    constexpr int poll = 100;
+    auto clock = m_clock.load(std::memory_order_relaxed);
+
+    if (clock >= m_drain) {
+        update();
+        return;
+    }
+
+    auto ms = clock == since || m_properties.rate <= 0 ? poll :
+              static_cast<int>(std::ceil((m_drain-clock)*1000.0/m_properties.rate))+1;
+
+    QTimer::singleShot(ms, this, [this, timer = m_drain_timer, clock] {
+        if (timer == m_drain_timer)
+            drain(clock);
+    });
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::compile()
+// ------------------------------------------------------------------------------------------------
+{
+    if (!m_complete)
+        // plan will be compiled once, when Graph is complete
+        return;
+
+    m_update = false;
+
+    auto plan = new Graph::plan;
+    std::vector<Node*> visited;
+
+    // Connections may have changed the number of channels of expanded Ports
+    // Control buffers are only allocated once, their channels remain capped to their capacity
+    expand();
+
+    // Audio buffers are reallocated with each plan (see allocate)
+    for (auto& node : m_nodes) {
+        for (auto& port : node->m_input_ports)
+            if (port->type() == Port::Audio)
+                port->m_capacity = port->nchannels();
+        for (auto& port : node->m_output_ports)
+            if (port->type() == Port::Audio)
+                port->m_capacity = port->nchannels();
+    }
+
+    routes(*plan);
+
+    auto sink = [](Node* node) { return node->m_sink || node->m_output_ports.empty(); };
+
+    // suspension: Nodes that can't be heard are processed until their tail has elapsed,
+    // they are then left out of the plan, and only resume once they can be heard again
+    std::vector<Node*> heard;
+    uint64_t clock = m_clock.load(std::memory_order_relaxed), drained = UINT64_MAX;
+    size_t nsuspended = 0;
+
+    if (m_suspend)
+        for (auto& node : m_nodes)
+            if (sink(node))
+                audible(*node, heard);
+
+    for (auto& node : m_nodes)
+    {
+        if (!m_suspend || std::find(heard.begin(), heard.end(), node) != heard.end()) {
+            node->m_suspended = node->m_draining = false;
+            continue;
+        }
+
+        if (!node->m_suspended && !node->m_draining) {
+            node->m_draining = true;
+            node->m_drained = clock + static_cast<uint64_t>(std::max(node->m_tail, 0));
+        }
+
+        if (node->m_draining && clock >= node->m_drained) {
+            node->m_draining = false;
+            node->m_suspended = true;
+        }
+
+        if (node->m_draining)
+            drained = std::min(drained, node->m_drained);
+        else nsuspended++;
+    }
+
+    // recompile once the first tail has been processed
+    m_drain = drained;
+    m_drain_timer++;
+
+    if (drained != UINT64_MAX)
+        drain(UINT64_MAX);
+
+    // reachability: only the Nodes from which a sink can be reached are compiled
+    for (auto& node : m_nodes)
+        if (sink(node))
+            compile(*plan, *node, visited);
+
+    size_t nculled = 0;
+
+    for (auto& node : m_nodes)
+    {
+        node->m_culled = std::find(visited.begin(), visited.end(), node) == visited.end();
+
+        if (node->m_culled)
+            nculled++;
+        else if (node->m_rate_pending) {
+            node->m_rate_pending = false;
+            node->on_rate_changed(m_properties.rate);
+        }
+    }
+
+    plan->accurate = m_accurate;
+
+    fuse(*plan);
+
+    pipeline(*plan);
+    allocate(*plan);
+    schedule(*plan);
+
+    // Midi and event outputs are cleared at the end of each run, for all registered Nodes,
+    // including the ones that are not part of the plan (e.g. External's Midi inputs)
+    for (auto& node : m_nodes)
+        for (auto& port : node->m_output_ports)
+            if (port->type() == Port::Midi_1_0 || port->type() == Port::Midi_2_0 || port->sparse()) {
+                Graph::operation clear;
+                clear.type = Graph::operation::Fill;
+                clear.port = port;
+                clear.nchannels = std::min(port->nchannels(), port->capacity());
+                plan->midi_outputs.push_back(clear);
+            }
+
+    if (m_executor)
+        m_executor->prepare(*plan);
+
+    qDebug() << "[GRAPH] compiled execution plan:" << plan->nnodes << "nodes,"
+             << plan->nedges << "connections," << nculled << "unreachable nodes culled,"
+             << nsuspended << "suspended," << plan->nstages << "stages";
+
+    auto latency = static_cast<uint32_t>((plan->nstages-1)*plan->nframes);
+
+    if (plan->nframes && m_period % plan->nframes)
+        // i/o goes through FIFOs (see External::process)
+        latency += plan->nframes;
+
+    if (m_plans.empty())
+        // first plan: the audio thread isn't running yet, we can bind it right away
+        // so that the i/o backends find their buffers before the first run
+        bind(*plan);
+
+    publish(plan);
+
+    // backends recompute their latencies (see JackExternal) once the plan is published
+    if (m_latency.exchange(latency) != latency)
+        emit latencyChanged(static_cast<int>(latency));
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::allocate(Graph::plan& plan)
+// each Audio Port gets a table of channel pointers, laid out at the beginning of the arena,
+// followed by the channel buffers, all starting on a cache line boundary
+// - linked Ports (see Port::link) point to their target's channels
+// - input Ports whose active Connections are identities (unity gain, zero add, not muted),
+//   and route exactly one source channel to each of their channels, point to
+//   their sources' channels (e.g. Dispatch::Split/Merge): their Fill operation is dropped,
+//   their Mix operations are replaced by Alias operations, Nodes read upstream output
+//   in place (they never write into their input buffers), they still get their own
+//   channel buffers, which their value is added into whenever it isn't zero
+// - intermediate Ports share a pool of channel buffers, assigned by interval colouring
+//   over the plan's task order (the lifetime of an input Port is its Node's task,
+//   an output Port lives until its last reader's task)
+// - other Ports (persistent, linked, read by feedback Connections, block-constant,
+//   not in the plan...) get their own channel buffers, block-constant input Ports
+//   (see Port::latch) are then only filled when their value changes
+// - Ports of culled Nodes (see Node::sink) get no channel buffers at all
+// - in pipelined plans, output Ports read by later stages get extra channel tables and buffers,
+//   one for each run their content has to be kept for (see Graph::ring)
+// sparse and Midi Ports keep their own buffers, unless plan's block is larger than the one
+// they've been allocated for: plan then brings buffers of its own, kept from the last plan
+// if it has the same size
+// ------------------------------------------------------------------------------------------------
+{
+    plan.nframes = m_properties.vector;
+
+    std::unordered_map<eventbuffer**, std::shared_ptr<eventbuffer>> events;
+    std::unordered_map<umpbuffer**, std::shared_ptr<umpbuffer>> packets;
+    std::unordered_map<midibuffer**, std::shared_ptr<midibuffer>> midi;
+    std::unordered_map<midibuffer*, std::shared_ptr<midibuffer>> shared;
+
+    if (!m_plans.empty() && m_plans.back()->nframes == plan.nframes) {
+        events.insert(m_plans.back()->events.begin(), m_plans.back()->events.end());
+        packets.insert(m_plans.back()->packets.begin(), m_plans.back()->packets.end());
+        midi.insert(m_plans.back()->midi.begin(), m_plans.back()->midi.end());
+    }
+
+    for (auto& node : m_nodes)
+        for (auto& ports : { &node->m_input_ports, &node->m_output_ports })
+            for (auto& port : *ports)
+            {
+                for (size_t c = 0; c < port->m_events.size(); ++c)
+                {
+                    auto slot = port->m_buffer.events+c;
+                    auto last = events.find(slot);
+
+                    if (plan.nframes <= port->m_nframes)
+                         plan.events.emplace_back(slot, port->m_events[c]);
+                    else if (last != events.end())
+                         plan.events.emplace_back(slot, last->second);
+                    else plan.events.emplace_back(slot, std::make_shared<eventbuffer>(plan.nframes));
+                }
+
+                for (size_t c = 0; c < port->m_packets.size(); ++c)
+                {
+                    auto slot = port->m_buffer.ump+c;
+                    auto last = packets.find(slot);
+
+                    if (plan.nframes <= port->m_nframes)
+                         plan.packets.emplace_back(slot, port->m_packets[c]);
+                    else if (last != packets.end())
+                         plan.packets.emplace_back(slot, last->second);
+                    else plan.packets.emplace_back(slot,
+                         std::make_shared<umpbuffer>(sizeof(sample_t)*plan.nframes));
+                }
+
+                for (size_t c = 0; c < port->m_midi.size(); ++c)
+                {
+                    // Ports sharing a buffer share the plan's one as well
+                    auto slot = port->m_buffer.midi+c;
+                    auto& buffer = shared[port->m_midi[c].get()];
+
+                    if (plan.nframes <= port->m_nframes)
+                        buffer = port->m_midi[c];
+                    else if (buffer == nullptr) {
+                        auto last = midi.find(slot);
+                        buffer = last != midi.end() ? last->second :
+                                 std::make_shared<midibuffer>(sizeof(sample_t)*plan.nframes);
+                    }
+
+                    plan.midi.emplace_back(slot, buffer);
+                }
+            }
+
+    constexpr uint32_t linked = UINT32_MAX;
+    // channels pointing to another Port's buffers (linked or aliased)
+    auto cbytes = wpn114::arena::align(sizeof(sample_t)*plan.nframes);
+    auto tbytes = [](nchannels_t nchannels) {
+        return wpn114::arena::align(sizeof(sample_t*)*std::max<size_t>(nchannels, 1));
+    };
+
+    // Nodes that are not part of the plan (see Node::sink) get empty channel tables,
+    // unless they own persistent Ports (i/o, Spatial...) or Ports linked from the plan
+    std::unordered_map<Node*, bool> live;
+
+    for (auto& operation : plan.operations)
+        if (operation.type == Graph::operation::Process)
+            live[operation.node] = true;
+
+    for (auto& node : m_nodes)
+        for (auto& ports : { &node->m_input_ports, &node->m_output_ports })
+            for (auto& port : *ports)
+                if (port->persistent())
+                    live[node] = true;
+
+    for (auto& node : m_nodes)
+        if (live.count(node))
+            for (auto& ports : { &node->m_input_ports, &node->m_output_ports })
+                for (auto& port : *ports)
+                    if (port->m_link)
+                        live[&port->m_link->parent_node()] = true;
+
+    auto layout = [&](std::vector<Port*>& ports, std::vector<audiobuffer_t>& pool)
+    {
+        size_t index = 0;
+
+        for (auto& port : ports)
+        {
+            if (port->type() != Port::Audio)
+                continue;
+
+            Graph::binding binding;
+            binding.port = port;
+            binding.nchannels = live.count(&port->parent_node()) ? port->nchannels() : 0;
+            binding.slot = index < pool.size() ? &pool[index] : nullptr;
+            plan.bindings.push_back(binding);
+            index++;
+        }
+    };
+
+    for (auto& node : m_nodes) {
+        layout(node->m_input_ports, node->m_input_pool.audio);
+        layout(node->m_output_ports, node->m_output_pool.audio);
+    }
+
+    // Port lifetimes, in plan's task indexes
+    std::unordered_map<Node*, uint32_t> tasks, processes;
+    std::unordered_map<Port*, std::pair<uint32_t, uint32_t>> readers;
+    std::unordered_map<Port*, bool> targets;
+
+    for (uint32_t t = 0; t < plan.tasks.size(); ++t)
+    {
+        auto& task = plan.tasks[t];
+
+        for (uint32_t o = task.begin; o < task.end; ++o)
+            if (plan.operations[o].type == Graph::operation::Process) {
+                tasks[plan.operations[o].node] = t;
+                processes[plan.operations[o].node] = o;
+            }
+
+        auto read = [&](Port* source) {
+            auto reader = readers.find(source);
+            if (reader == readers.end())
+                 readers[source] = { t, t };
+            else reader->second.second = t;
+        };
+
+        for (uint32_t o = task.begin; o < task.end; ++o) {
+            auto& operation = plan.operations[o];
+            if (operation.type == Graph::operation::Reduce) {
+                // target keeps its content until its final sum is mixed
+                read(operation.connection->source());
+                read(operation.target);
+            }
+            else if (operation.type == Graph::operation::Mix)
+                read(operation.connection->source());
+        }
+    }
+
+    for (auto& binding : plan.bindings)
+        if (binding.port->m_link)
+            targets[binding.port->m_link] = true;
+
+    std::unordered_map<Port*, bool> constants;
+
+    for (auto& operation : plan.operations)
+        if (operation.type == Graph::operation::Latch)
+            constants[operation.port] = true;
+
+    // pipelined plans: output Ports read by later stages get one channel table
+    // for each run their content has to be kept for
+    std::unordered_map<Port*, uint8_t> depths;
+    std::unordered_map<Port*, uint32_t> rings;
+
+    for (auto& operation : plan.operations)
+        if (operation.type == Graph::operation::Mix && operation.delay) {
+            auto& depth = depths[operation.connection->source()];
+            depth = std::max<uint8_t>(depth, operation.delay+1);
+        }
+
+    std::unordered_map<Port*, bool> aliases;
+    std::unordered_map<Port*, nchannels_t> nchannels;
+    std::vector<std::pair<Port*, nchannels_t>> view;
+
+    for (auto& binding : plan.bindings)
+         nchannels[binding.port] = binding.nchannels;
+
+    for (auto& binding : plan.bindings)
+    {
+        auto port = binding.port;
+        auto task = tasks.find(&port->parent_node());
+
+        if (port->polarity() != Polarity::Input || task == tasks.end() || port->persistent() ||
+            port->m_link || targets.count(port) || binding.nchannels == 0 ||
+            port->m_schedule.load())
+            continue;
+
+        view.assign(binding.nchannels, { nullptr, 0 });
+        bool valid = true;
+
+        for (auto& connection : port->connections())
+        {
+            if (!connection->active())
+                continue;
+
+            if (connection->muted() ||
+                wpn114::mix::select(connection->mul(), connection->add()) != wpn114::mix::Accumulate) {
+                valid = false;
+                break;
+            }
+
+            // source has to be processed before (by an earlier task, or earlier in a fused one)
+            auto source = connection->source();
+            auto stask = tasks.find(&source->parent_node());
+            auto snchannels = nchannels.find(source);
+            auto route = plan.routes.find(connection);
+
+            if (stask == tasks.end() || stask->second > task->second ||
+                processes[&source->parent_node()] >= processes[&port->parent_node()] ||
+                snchannels == nchannels.end() || route == plan.routes.end()) {
+                valid = false;
+                break;
+            }
+
+            // pipelined plans: source buffers may be rotated at each run, dest has to keep its own
+            if (depths.count(source) ||
+               (!plan.stages.empty() && plan.stages[stask->second] != plan.stages[task->second])) {
+                valid = false;
+                break;
+            }
+
+            auto cables = plan.cables.data() + route->second.begin;
+
+            for (nchannels_t c = 0; c < route->second.ncables && valid; ++c) {
+                auto& cable = cables[c];
+                valid = cable[0] < snchannels->second && cable[1] < binding.nchannels &&
+                        view[cable[1]].first == nullptr;
+                if (valid)
+                    view[cable[1]] = { source, cable[0] };
+            }
+
+            if (!valid)
+                break;
+        }
+
+        // each dest channel has to read exactly one source channel, nothing is mixed anymore
+        if (!valid || std::any_of(view.begin(), view.end(),
+                                  [](std::pair<Port*, nchannels_t> const& v) { return v.first == nullptr; }))
+            continue;
+
+        binding.alias = true;
+        binding.view = static_cast<uint32_t>(plan.views.size());
+        plan.views.insert(plan.views.end(), view.begin(), view.end());
+        aliases[port] = true;
+    }
+
+    struct interval { uint32_t begin, end; size_t binding; };
+    std::vector<interval> intervals;
+
+    for (size_t n = 0; n < plan.bindings.size(); ++n)
+    {
+        auto port = plan.bindings[n].port;
+        auto task = tasks.find(&port->parent_node());
+
+        // Ports processed by multiple threads keep their own buffers
+        // otherwise, independent branches would have to wait on each other
+        if (m_executor || task == tasks.end() || port->persistent() || port->m_link ||
+            plan.bindings[n].alias || targets.count(port) || constants.count(port) ||
+            plan.bindings[n].nchannels == 0)
+            continue;
+
+        interval i = { task->second, task->second, n };
+
+        if (port->polarity() == Polarity::Output) {
+            auto reader = readers.find(port);
+            if (reader != readers.end()) {
+                if (reader->second.first <= i.begin)
+                    // read by a feedback Connection, content has to remain until next run
+                    continue;
+                i.end = reader->second.second;
+            }
+        }
+
+        intervals.push_back(i);
+    }
+
+    std::stable_sort(intervals.begin(), intervals.end(),
+        [](interval const& lhs, interval const& rhs) { return lhs.begin < rhs.begin; });
+
+    // channel buffer assigned to each binding channel
+    std::vector<size_t> channels(plan.bindings.size()+1, 0);
+
+    for (size_t n = 0; n < plan.bindings.size(); ++n)
+         channels[n+1] = channels[n] + plan.bindings[n].nchannels;
+
+    plan.buffers.assign(channels.back(), linked);
+
+    std::priority_queue<std::pair<uint32_t, uint32_t>,
+                        std::vector<std::pair<uint32_t, uint32_t>>,
+                        std::greater<std::pair<uint32_t, uint32_t>>> active;
+
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> available;
+    std::vector<uint32_t> users;
+    uint32_t nshared = 0;
+
+    for (auto& i : intervals)
+    {
+        while (!active.empty() && active.top().first < i.begin) {
+            available.push(active.top().second);
+            active.pop();
+        }
+
+        for (nchannels_t c = 0; c < plan.bindings[i.binding].nchannels; ++c)
+        {
+            uint32_t buffer;
+
+            if (available.empty()) {
+                buffer = nshared++;
+                users.push_back(0);
+            } else {
+                buffer = available.top();
+                available.pop();
+            }
+
+            users[buffer]++;
+            active.emplace(i.end, buffer);
+            plan.buffers[channels[i.binding]+c] = buffer;
+        }
+    }
+
+    uint32_t nbuffers = nshared;
+    size_t nnaive = 0;
+
+    for (size_t n = 0; n < plan.bindings.size(); ++n)
+    {
+        if (plan.bindings[n].port->m_link)
+            continue;
+
+        nnaive += plan.bindings[n].nchannels;
+
+        for (auto c = channels[n]; c < channels[n+1]; ++c)
+            if (plan.buffers[c] == linked)
+                plan.buffers[c] = nbuffers++;
+    }
+
+    // shared output buffers may hold another Port's content,
+    // they are cleared right before their Node is processed
+    std::vector<Graph::operation> operations;
+    std::unordered_map<Node*, std::vector<Graph::operation>> clears;
+
+    for (size_t n = 0; n < plan.bindings.size(); ++n)
+    {
+        auto& binding = plan.bindings[n];
+
+        if (binding.port->polarity() != Polarity::Output || binding.nchannels == 0)
+            continue;
+
+        // each channel may land in a different shared buffer
+        bool shared = false;
+
+        for (nchannels_t c = 0; c < binding.nchannels && !shared; ++c) {
+             auto buffer = plan.buffers[channels[n]+c];
+             shared = buffer < nshared && users[buffer] > 1;
+        }
+
+        if (shared) {
+            Graph::operation clear;
+            clear.type = Graph::operation::Clear;
+            clear.port = binding.port;
+            clear.nchannels = binding.nchannels;
+            clears[&binding.port->parent_node()].push_back(clear);
+        }
+    }
+
+    if (!clears.empty() || !aliases.empty())
+    {
+        for (auto& task : plan.tasks)
+        {
+            auto begin = static_cast<uint32_t>(operations.size());
+            auto fused = std::find_if(plan.operations.begin()+task.begin, plan.operations.begin()+task.end,
+                         [](Graph::operation const& o) {
+                             return o.type == Graph::operation::Fuse || o.type == Graph::operation::Transform;
+                         });
+
+            // Nodes are processed by the last operation, or by the ones following Fuse/Transform
+            // their shared buffers are cleared before, reduction tasks have none
+            auto first = fused != plan.operations.begin()+task.end ?
+                         static_cast<uint32_t>(fused-plan.operations.begin()) : task.end-1;
+
+            for (auto o = task.begin; o < task.end; ++o)
+            {
+                auto operation = plan.operations[o];
+
+                if (o == first)
+                    for (auto p = first; p < task.end; ++p) {
+                        if (plan.operations[p].type != Graph::operation::Process)
+                            continue;
+                        auto clear = clears.find(plan.operations[p].node);
+                        if (clear != clears.end())
+                            operations.insert(operations.end(), clear->second.begin(), clear->second.end());
+                    }
+
+                if (operation.type == Graph::operation::Fill && aliases.count(operation.port))
+                    continue;
+
+                if (operation.type == Graph::operation::Mix &&
+                    aliases.count(operation.connection->dest()))
+                    operation.type = Graph::operation::Alias;
+
+                operations.push_back(operation);
+            }
+
+            task.begin = begin;
+            task.end = static_cast<uint32_t>(operations.size());
+        }
+
+        plan.operations = std::move(operations);
+    }
+
+    for (auto& binding : plan.bindings)
+    {
+        auto depth = depths.find(binding.port);
+        if (depth == depths.end() || binding.nchannels == 0)
+            continue;
+
+        Graph::ring ring;
+        ring.port = binding.port;
+        ring.slot = binding.slot;
+        ring.nchannels = binding.nchannels;
+        ring.depth = depth->second;
+        ring.begin = static_cast<uint32_t>(plan.ring_tables.size());
+        plan.ring_tables.resize(plan.ring_tables.size()+ring.depth, nullptr);
+        rings[binding.port] = static_cast<uint32_t>(plan.rings.size());
+        plan.rings.push_back(ring);
+    }
+
+    for (auto& operation : plan.operations)
+        if (operation.type == Graph::operation::Mix && operation.delay) {
+            auto ring = rings.find(operation.connection->source());
+            if (ring != rings.end())
+                 operation.ring = ring->second;
+            else operation.delay = 0;
+        }
+
+    qDebug() << "[GRAPH] audio buffers:" << nbuffers << "allocated,"
+             << nshared << "shared by" << nnaive-(nbuffers-nshared) << "Port channels,"
+             << nnaive << "without reuse," << aliases.size() << "Ports aliased,"
+             << plan.rings.size() << "Ports pipelined";
+
+    if (!m_plans.empty())
+    {
+        // keep the current arena if nothing has moved
+        auto& last = *m_plans.back();
+        auto same = [](Graph::binding const& lhs, Graph::binding const& rhs) {
+            return lhs.port == rhs.port && lhs.slot == rhs.slot &&
+                   lhs.alias == rhs.alias && lhs.view == rhs.view && lhs.nchannels == rhs.nchannels;
+        };
+
+        auto same_ring = [](Graph::ring const& lhs, Graph::ring const& rhs) {
+            return lhs.port == rhs.port && lhs.depth == rhs.depth;
+        };
+
+        if (last.nframes == plan.nframes && last.arena && last.buffers == plan.buffers &&
+            last.views == plan.views &&
+            std::equal(plan.bindings.begin(), plan.bindings.end(),
+                       last.bindings.begin(), last.bindings.end(), same) &&
+            std::equal(plan.rings.begin(), plan.rings.end(),
+                       last.rings.begin(), last.rings.end(), same_ring)) {
+            plan.arena = last.arena;
+            plan.bindings = last.bindings;
+            plan.ring_tables = last.ring_tables;
+            return;
+        }
+    }
+
+    size_t nbytes = 0;
+    for (auto& binding : plan.bindings)
+         nbytes += tbytes(binding.nchannels)*(binding.alias ? 2 : 1);
+
+    auto offset = nbytes;
+    nbytes += cbytes*nbuffers;
+
+    auto roffset = nbytes;
+    for (auto& ring : plan.rings)
+         nbytes += (ring.depth-1)*(tbytes(ring.nchannels)+cbytes*ring.nchannels);
+
+    plan.arena = std::make_shared<wpn114::arena>(nbytes, m_hugepages, m_mlock);
+    auto& arena = *plan.arena;
+
+    if (arena.data() == nullptr) {
+        Graph::debug("could not allocate audio buffers");
+        plan.bindings.clear();
+        plan.rings.clear();
+        for (auto& operation : plan.operations)
+             operation.delay = 0;
+        return;
+    }
+
+    std::unordered_map<Port*, audiobuffer_t> tables;
+    size_t table = 0;
+
+    for (size_t n = 0; n < plan.bindings.size(); ++n)
+    {
+        auto& binding = plan.bindings[n];
+        binding.table = arena.at<sample_t*>(table);
+        tables[binding.port] = binding.table;
+        table += tbytes(binding.nchannels);
+
+        for (nchannels_t c = 0; c < binding.nchannels; ++c) {
+            auto buffer = plan.buffers[channels[n]+c];
+            if (buffer != linked)
+                binding.table[c] = arena.at<sample_t>(offset+buffer*cbytes);
+        }
+
+        if (binding.alias) {
+            // table is set to the view below, its own buffers are kept aside
+            binding.own = arena.at<sample_t*>(table);
+            table += tbytes(binding.nchannels);
+            std::copy(binding.table, binding.table+binding.nchannels, binding.own);
+        }
+    }
+
+    for (auto& binding : plan.bindings)
+    {
+        auto port = binding.port;
+
+        if (port->m_link == nullptr)
+            continue;
+
+        auto target = tables.find(port->m_link);
+        auto ntarget = port->m_link->nchannels();
+
+        for (nchannels_t c = 0; c < binding.nchannels; ++c) {
+            if (target == tables.end() || c >= port->m_link_channels.size() ||
+                port->m_link_channels[c] >= ntarget)
+                 qDebug() << "[GRAPH] invalid link for Port" << port->name();
+            else binding.table[c] = target->second[port->m_link_channels[c]];
+        }
+    }
+
+    for (auto& binding : plan.bindings)
+        if (binding.alias)
+            for (nchannels_t c = 0; c < binding.nchannels; ++c) {
+                auto& view = plan.views[binding.view+c];
+                binding.table[c] = tables[view.first][view.second];
+            }
+
+    for (auto& ring : plan.rings)
+    {
+        plan.ring_tables[ring.begin] = tables[ring.port];
+
+        for (uint8_t d = 1; d < ring.depth; ++d)
+        {
+            auto table = arena.at<sample_t*>(roffset);
+            roffset += tbytes(ring.nchannels);
+
+            for (nchannels_t c = 0; c < ring.nchannels; ++c, roffset += cbytes)
+                 table[c] = arena.at<sample_t>(roffset);
+
+            plan.ring_tables[ring.begin+d] = table;
+        }
+    }
+
+    qDebug() << "[GRAPH] allocated audio buffer arena:" << arena.size() << "bytes,"
+             << plan.bindings.size() << "ports"
+             << (arena.hugepages() ? "(huge pages)" : "")
+             << (arena.locked() ? "(locked)" : "");
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::bind(Graph::plan const& plan) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    for (auto& binding : plan.bindings) {
+        binding.port->m_buffer.audio = binding.table;
+        binding.port->m_bound_nchannels = binding.nchannels;
+        binding.port->m_own = binding.own;
+        binding.port->m_latched = false;
+        if (binding.slot)
+           *binding.slot = binding.table;
+    }
+
+    for (auto& events : plan.events)
+        if (*events.first != events.second.get()) {
+           *events.first = events.second.get();
+            events.second->clear();
+        }
+
+    for (auto& packets : plan.packets)
+        if (*packets.first != packets.second.get()) {
+           *packets.first = packets.second.get();
+            packets.second->clear();
+        }
+
+    for (auto& midi : plan.midi)
+        if (*midi.first != midi.second.get()) {
+           *midi.first = midi.second.get();
+            midi.second->clear();
+        }
+
+    rotate(plan);
+    m_arena = plan.arena.get();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::publish(Graph::plan* plan)
+// ------------------------------------------------------------------------------------------------
+{
+    plan->epoch = ++m_epochs;
+
+    // if the previous plan hasn't been picked up by the audio thread yet
+    // it never will, we can safely delete it
+    if (auto unused = m_pending.exchange(plan, std::memory_order_acq_rel)) {
+        m_plans.remove(unused);
+        delete unused;
+    }
+
+    m_plans.push_back(plan);
+    collect();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::retire(Connection& connection)
+// ------------------------------------------------------------------------------------------------
+{
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        if (&(*it) != &connection)
+            continue;
+
+        // the next published plan will be the first one not referencing it
+        std::list<Connection> retired;
+        retired.splice(retired.begin(), m_connections, it);
+        m_retired.emplace_back(m_epochs+1, std::move(retired));
+        return;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Graph::collect()
+// the audio thread only swaps plans in between two runs,
+// once it runs a plan, it won't ever access older ones
+// ------------------------------------------------------------------------------------------------
+{
+    auto epoch = m_epoch.load(std::memory_order_acquire);
+
+    for (auto it = m_plans.begin(); it != m_plans.end();) {
+        if ((*it)->epoch < epoch) {
+            delete *it;
+            it = m_plans.erase(it);
+        } else ++it;
+    }
+
+    for (auto it = m_retired.begin(); it != m_retired.end();) {
+        if (it->first <= epoch)
+             it = m_retired.erase(it);
+        else ++it;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD vector_t
+Graph::run(Graph::plan const& plan) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    vector_t nframes = plan.nframes;
+
+    if (m_executor && plan.tasks.size() > 1)
+         m_executor->run(plan, nframes);
+    else run(plan.operations.data(), plan.operations.data()+plan.operations.size(), nframes);
+
+    auto midi_outputs = plan.midi_outputs.data();
+    run(midi_outputs, midi_outputs+plan.midi_outputs.size(), nframes);
+
+    if (!plan.rings.empty()) {
+        m_runs++;
+        rotate(plan);
+    }
+
+    return nframes;
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::rotate(Graph::plan const& plan) noexcept
+// pipelined Ports are bound to the channel table of the next run
+// the table may hold an earlier block: silence has to be detected again
+// ------------------------------------------------------------------------------------------------
+{
+    for (auto& ring : plan.rings)
+    {
+        auto table = plan.ring_tables[ring.begin + m_runs % ring.depth];
+        ring.port->m_buffer.audio = table;
+        ring.port->m_silent.reset();
+        if (ring.slot)
+           *ring.slot = table;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::run(Graph::plan const& plan, Graph::task const& task, vector_t nframes) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    auto operations = plan.operations.data();
+    run(operations+task.begin, operations+task.end, nframes);
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::run(Graph::operation const* begin, Graph::operation const* end, vector_t nframes) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    // scheduled values are due at block start for the Nodes processing segments,
+    // anywhere within the block for the others
+    auto time = m_clock.load(std::memory_order_relaxed);
+    auto due = [this, time, nframes](Port& port) {
+        return m_current->accurate && port.m_parent->m_accurate ? time+1 : time+nframes;
+    };
+
+    for (auto operation = begin; operation != end; ++operation)
+    {
+        switch(operation->type)
+        {
+        case Graph::operation::Fill:
+        {
+            auto port = operation->port;
+            if  (port->type() == Port::Audio) {
+                 port->dequeue(due(*port));
+                 port->pull_value(nframes, operation->nchannels);
+            }
+            else if (port->type() == Port::Control) {
+                 port->dequeue(due(*port));
+                 port->pull_control(operation->nchannels);
+            }
+            else port->clear(operation->nchannels);
+            break;
+        }
+        case Graph::operation::Mix:
+        {
+            audiobuffer_t source = nullptr;
+
+            if (operation->delay) {
+                // source has been processed delay runs before, by an earlier stage
+                auto& ring = m_current->rings[operation->ring];
+                source = m_current->ring_tables[ring.begin +
+                         (m_runs+ring.depth-operation->delay) % ring.depth];
+            }
+
+            operation->connection->pull(nframes, operation->cables, operation->nchannels,
+                                        operation->variant, operation->kernel, source,
+                                        operation->reduced);
+            break;
+        }
+
+        case Graph::operation::Latch:
+            operation->port->dequeue(due(*operation->port));
+            operation->port->latch(nframes, operation->nchannels);
+            break;
+
+        case Graph::operation::Alias:
+        {
+            // dest Port isn't block-constant, and its channels belong to the source Ports,
+            // unless it has a value: source channels are then offset into its own buffers
+            auto port = operation->connection->dest();
+            auto source = operation->connection->source();
+            sample_t v = port->current();
+            port->m_scalar = v;
+            port->m_constant = port->m_latched = false;
+            port->m_aliased = v == 0;
+
+            for (nchannels_t c = 0; c < operation->nchannels; ++c)
+            {
+                auto cable = operation->cables[c];
+                auto sbuf = source->m_buffer.audio[cable[0]];
+
+                if (v == 0) {
+                    port->m_buffer.audio[cable[1]] = sbuf;
+                    port->m_silent[cable[1]] = source->m_silent[cable[0]];
+                    continue;
+                }
+
+                auto dbuf = port->m_buffer.audio[cable[1]] = port->m_own[cable[1]];
+                port->m_silent[cable[1]] = false;
+
+                for (vector_t f = 0; f < nframes; ++f)
+                     dbuf[f] = sbuf[f]+v;
+            }
+            break;
+        }
+
+        case Graph::operation::Reduce:
+        {
+            // source is summed into target, the parent only mixes target
+            auto connection = operation->connection;
+            auto source = connection->source(), target = operation->target;
+            auto sbuf = source->buffer<audiobuffer_t>();
+            auto tbuf = target->buffer<audiobuffer_t>();
+            auto nchannels = std::min({ operation->nchannels, source->m_bound_nchannels,
+                                        target->m_bound_nchannels });
+
+            if (auto scale = operation->scale)
+            {
+                // target's own gain is applied in place, before anything is summed into it
+                bool muted = scale->muted();
+                sample_t mul = muted ? 0 : scale->mul(), add = muted ? 0 : scale->add();
+
+                for (nchannels_t c = 0; c < nchannels; ++c)
+                {
+                    if ((mul == 1 || target->silent(c)) && add == 0)
+                        continue;
+
+                    for (vector_t f = 0; f < nframes; ++f)
+                         tbuf[c][f] = tbuf[c][f]*mul+add;
+
+                    target->set_silent(c, mul == 0 && add == 0);
+                }
+            }
+
+            if (connection->muted())
+                break;
+
+            sample_t mul = connection->mul(), add = connection->add();
+            auto kernel = operation->kernel;
+
+            // mul/add may have changed, same as Connection::pull
+            if ((wpn114::mix::select(mul, add) | operation->variant) != operation->variant)
+                kernel = wpn114::mix::get(wpn114::mix::Affine);
+
+            for (nchannels_t c = 0; c < nchannels; ++c)
+            {
+                if (add == 0 && source->silent(c))
+                    continue;
+
+                kernel(tbuf[c], sbuf[c], mul, add, nframes);
+                target->set_silent(c, false);
+            }
+            break;
+        }
+
+        case Graph::operation::Clear:
+        {
+            auto buffer = operation->port->buffer<audiobuffer_t>();
+            for (nchannels_t c = 0; c < operation->nchannels; ++c)
+                 memset(buffer[c], 0, sizeof(sample_t)*nframes);
+            operation->port->m_silent.set();
+            break;
+        }
+        case Graph::operation::Fuse:
+            tile(operation+1, operation+1+operation->length, nframes);
+            operation += operation->length;
+            break;
+
+        case Graph::operation::Transform:
+            transform(operation+1, operation+1+operation->length);
+            operation += operation->length;
+            break;
+
+        case Graph::operation::Process:
+        {
+            auto node = operation->node;
+
+            if (node->idle(nframes)) {
+                node->silence(nframes);
+                break;
+            }
+
+            for (auto& port : node->m_output_ports)
+                 port->m_silent.reset();
+
+            if  (m_current->accurate && node->m_accurate)
+                 split(*node, nframes);
+            else node->expand(0, nframes);
+
+            node->detect_silence(nframes);
+        }
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::split(Node& node, vector_t nframes) noexcept
+// segment boundaries are merged once for the whole block, in a fixed-size sorted array:
+// past its capacity, the remaining events are processed with the segment holding them
+// ------------------------------------------------------------------------------------------------
+{
+    constexpr size_t capacity = 64;
+    vector_t bounds[capacity];
+    size_t nbounds = 0;
+
+    auto time = m_clock.load(std::memory_order_relaxed);
+
+    auto insert = [&](vector_t frame) {
+        if (frame == 0 || frame >= nframes)
+            return;
+        auto bound = std::lower_bound(bounds, bounds+nbounds, frame);
+        if ((bound != bounds+nbounds && *bound == frame) || nbounds == capacity)
+            return;
+        std::move_backward(bound, bounds+nbounds, bounds+nbounds+1);
+        *bound = frame;
+        nbounds++;
+    };
+
+    for (auto& port : node.m_input_ports)
+    {
+        if (port->type() == Port::Midi_1_0) {
+            // events are usually sorted, inserting them is cheap
+            for (nchannels_t c = 0; c < port->m_bound_nchannels; ++c)
+                for (auto& event : *port->m_buffer.midi[c])
+                     insert(event.frame);
+            continue;
+        }
+
+        if (port->sparse()) {
+            for (nchannels_t c = 0; c < port->m_bound_nchannels; ++c)
+                for (auto& event : *port->m_buffer.events[c])
+                     insert(event.frame);
+            continue;
+        }
+
+        if (port->type() == Port::Midi_2_0) {
+            for (nchannels_t c = 0; c < port->m_bound_nchannels; ++c)
+                for (size_t p = 0; p < port->m_buffer.ump[c]->count(); ++p)
+                     insert(port->m_buffer.ump[c]->frames()[p]);
+            continue;
+        }
+
+        auto schedule = port->m_schedule.load(std::memory_order_acquire);
+
+        if (schedule == nullptr || port->m_aliased)
+            continue;
+
+        auto head = schedule->head.load(std::memory_order_acquire);
+
+        for (auto tail = schedule->tail.load(std::memory_order_relaxed); tail != head; ++tail) {
+            auto event = schedule->events[tail % Port::schedule::capacity].first;
+            if (event >= time+nframes)
+                break;
+            insert(static_cast<vector_t>(event-time));
+        }
+    }
+
+    vector_t offset = 0;
+
+    for (size_t n = 0; n <= nbounds; ++n)
+    {
+        auto end = n < nbounds ? bounds[n] : nframes;
+
+        if (offset)
+            for (auto& port : node.m_input_ports)
+                if (port->type() == Port::Audio || port->type() == Port::Control)
+                    port->apply(time+offset, offset, nframes);
+
+        node.expand(offset, end-offset);
+        offset = end;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::tile(Graph::operation const* begin, Graph::operation const* end, vector_t nframes) noexcept
+// the chain's Nodes process segments of at most 64 frames, one after the other,
+// their Connections are mixed segment by segment
+// output silence is unknown until the whole block has been processed: all cables are mixed
+// ------------------------------------------------------------------------------------------------
+{
+    constexpr vector_t size = 64;
+
+    for (auto operation = begin; operation != end; ++operation) {
+        if (operation->type == Graph::operation::Process) {
+            for (auto& port : operation->node->m_output_ports)
+                 port->m_silent.reset();
+        }
+        else if (operation->type == Graph::operation::Alias)
+            run(operation, operation+1, nframes);
+    }
+
+    for (vector_t offset = 0; offset < nframes; offset += size)
+    {
+        auto n = std::min<vector_t>(size, nframes-offset);
+
+        for (auto operation = begin; operation != end; ++operation)
+        {
+            if (operation->type == Graph::operation::Process) {
+                operation->node->expand(offset, n);
+                continue;
+            }
+
+            if (operation->type != Graph::operation::Mix || operation->connection->muted())
+                continue;
+
+            auto connection = operation->connection;
+            auto dest = connection->dest();
+            auto sbuf = connection->source()->buffer<audiobuffer_t>();
+            auto dbuf = dest->buffer<audiobuffer_t>();
+            auto kernel = operation->kernel;
+            sample_t mul = connection->mul(), add = connection->add();
+
+            // mul/add may have changed, same as Connection::pull
+            if (kernel == nullptr || (wpn114::mix::select(mul, add) | operation->variant) != operation->variant)
+                kernel = wpn114::mix::get(wpn114::mix::Affine);
+
+            for (nchannels_t c = 0; c < operation->nchannels; ++c) {
+                auto cable = operation->cables[c];
+                kernel(dbuf[cable[1]]+offset, sbuf[cable[0]]+offset, mul, add, n);
+                dest->set_silent(cable[1], false);
+            }
+        }
+    }
+
+    for (auto operation = begin; operation != end; ++operation)
+        if (operation->type == Graph::operation::Process)
+            operation->node->detect_silence(nframes);
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::transform(Graph::operation const* begin, Graph::operation const* end) noexcept
+// the first Node's input events go through the chain's filters, in place,
+// the remaining ones are copied once, into the last Node's output
+// Connections aren't pulled, a muted one drops the events reaching it, same as Connection::pull
+// ------------------------------------------------------------------------------------------------
+{
+    auto first = begin->node, last = (end-1)->node;
+    auto in = first->m_input_pool.midi[0][0];
+    auto out = last->m_output_pool.midi[0][0];
+
+    for (auto& event : *in)
+    {
+        bool keep = true;
+
+        for (auto operation = begin; operation != end && keep; ++operation)
+             keep = operation->type == Graph::operation::Mix ?
+                    !operation->connection->muted() :
+                    operation->node->rtransform(event, operation->node->m_input_pool);
+
+        if (keep)
+            out->push(event);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Graph::pull(Connection& connection, vector_t nframes) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    if (m_current == nullptr)
+        return;
+
+    auto route = m_current->routes.find(&connection);
+    if (route == m_current->routes.end())
+        // Connection has been added after the current plan
+        return;
+
+    connection.pull(nframes, m_current->cables.data() + route->second.begin,
+                    route->second.ncables);
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD vector_t
+Graph::next() noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    // pick up the latest published plan (if any)
+    // this is the only synchronization point with the Qt/GUI thread
+    if (auto plan = m_pending.exchange(nullptr, std::memory_order_acq_rel)) {
+        if (plan->arena.get() != m_arena)
+            bind(*plan);
+        m_current = plan;
+        m_epoch.store(plan->epoch, std::memory_order_release);
+    }
+
+    return m_current ? m_current->nframes : 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD vector_t
+Graph::run() noexcept
+// the main processing function
+// ------------------------------------------------------------------------------------------------
+{
+    next();
+
+    if (m_current == nullptr)
+        return m_properties.vector;
+
+    auto nframes = run(*m_current);
+    m_clock.fetch_add(nframes, std::memory_order_relaxed);
+
+    return nframes;
+}
+
+#include <wpn114audio/spatial.hpp>
+
+// ------------------------------------------------------------------------------------------------
+Node::~Node()
+// ------------------------------------------------------------------------------------------------
+{
+    if (m_spatial)
+        delete m_spatial;
+
+    Graph::instance().unregister_node(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+Spatial*
+Node::spatial()
+// if qml requests access to spatial, we have to create it
+// ------------------------------------------------------------------------------------------------
+{
+    if (!m_spatial) {
+        qDebug() << m_name << "creating spatial attributes";
+
+        m_spatial = new Spatial(default_port(Polarity::Output)->nchannels());
+        // we make an implicit connection
+        m_subnodes.push_front(m_spatial);
+    }
+
+    return m_spatial;
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Node::allocate_pools()
+// ------------------------------------------------------------------------------------------------
+{
+    for (auto& port : m_input_ports)
+        if (port->type() == Port::Audio)
+             m_input_pool.audio.push_back(port->buffer<audiobuffer_t>());
+        else if (port->type() == Port::Control)
+             m_input_pool.control.push_back(port->buffer<controlbuffer_t>());
+        else if (port->sparse())
+             m_input_pool.events.push_back(port->buffer<eventbuffer_t>());
+        else if (port->type() == Port::Midi_2_0)
+             m_input_pool.ump.push_back(port->buffer<umpbuffer_t>());
+        else m_input_pool.midi.push_back(port->buffer<midibuffer_t>());
+
+    for (auto& port : m_output_ports)
+        if (port->type() == Port::Audio)
+             m_output_pool.audio.push_back(port->buffer<audiobuffer_t>());
+        else if (port->type() == Port::Control)
+             m_output_pool.control.push_back(port->buffer<controlbuffer_t>());
+        else if (port->sparse())
+             m_output_pool.events.push_back(port->buffer<eventbuffer_t>());
+        else if (port->type() == Port::Midi_2_0)
+             m_output_pool.ump.push_back(port->buffer<umpbuffer_t>());
+        else m_output_pool.midi.push_back(port->buffer<midibuffer_t>());
+
+    m_lane_inputs = m_input_pool;
+    m_lane_outputs = m_output_pool;
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Node::expand(vector_t offset, vector_t nframes) noexcept
+// lane pools have the same size as the Node's pools, only their entries are offset
+// ------------------------------------------------------------------------------------------------
+{
+    if (m_dispatch != Dispatch::Values::Expand || !m_expandable) {
+        rwrite(m_input_pool, m_output_pool, offset, nframes);
+        return;
+    }
+
+    nchannels_t nlanes = 0;
+
+    for (auto& port : m_input_ports)
+        if (port->type() == Port::Audio || port->type() == Port::Control)
+            nlanes = std::max(nlanes, port->m_bound_nchannels);
+
+    auto lanes = [](std::vector<Port*>& ports, pool& source, pool& dest, nchannels_t lane) {
+        size_t a = 0, c = 0;
+        for (auto& port : ports) {
+            auto channel = lane < port->m_bound_nchannels ? lane : 0;
+            if (port->type() == Port::Audio) {
+                dest.audio[a] = source.audio[a]+channel;
+                a++;
+            }
+            else if (port->type() == Port::Control) {
+                dest.control[c] = source.control[c]+channel;
+                c++;
+            }
+        }
+    };
+
+    for (nchannels_t lane = 0; lane < std::max<nchannels_t>(nlanes, 1); ++lane) {
+        lanes(m_input_ports, m_input_pool, m_lane_inputs, lane);
+        lanes(m_output_ports, m_output_pool, m_lane_outputs, lane);
+        rwrite(m_lane_inputs, m_lane_outputs, offset, nframes);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD bool
+Node::idle(vector_t nframes) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    if (m_tail < 0)
+        return false;
+
+    bool inputs = false;
+
+    for (auto& port : m_input_ports) {
+        if (!port->is_default())
+            continue;
+        if (!port->silent()) {
+            m_idle = 0;
+            return false;
+        }
+        inputs = true;
+    }
+
+    if (!inputs)
+        // nothing to wait for
+        return false;
+
+    if (m_idle >= m_tail)
+        return true;
+
+    m_idle += nframes;
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Node::silence(vector_t nframes) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    for (auto& port : m_output_ports)
+    {
+        if (port->type() == Port::Control) {
+            for (nchannels_t c = 0; c < port->m_capacity; ++c)
+                 port->m_buffer.control[c] = {};
+            continue;
+        }
+
+        if (port->type() != Port::Audio)
+            continue;
+
+        auto buffer = port->buffer<audiobuffer_t>();
+
+        for (nchannels_t c = 0; c < port->m_bound_nchannels; ++c)
+            if (!port->silent(c)) {
+                memset(buffer[c], 0, sizeof(sample_t)*nframes);
+                port->set_silent(c);
+            }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+WPN_AUDIOTHREAD void
+Node::detect_silence(vector_t nframes) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    for (auto& port : m_output_ports)
+    {
+        if (port->type() != Port::Audio)
+            continue;
+
+        auto buffer = port->buffer<audiobuffer_t>();
+
+        for (nchannels_t c = 0; c < port->m_bound_nchannels; ++c)
+            if (!port->silent(c))
+                port->set_silent(c, wpn114::mix::zero(buffer[c], nframes));
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// CONNECTION
+//-------------------------------------------------------------------------------------------------
+Connection::Connection(Port& source, Port& dest, Routing matrix) :
+    m_source   (&source),
+    m_dest     (&dest),
+    m_routing  (matrix)
+{
+    componentComplete();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Connection::setTarget(const QQmlProperty& target)
+// qml property binding, e. g.:
+// Connection on 'Port' { level: db(-12); routing: [0, 1] }
+// ------------------------------------------------------------------------------------------------
+{
+    auto port = target.read().value<Port*>();
+
+    switch(port->polarity()) {
+        case Polarity::Output: m_source = port; break;
+        case Polarity::Input: m_dest = port;
+    }
+
+    componentComplete();
+    Graph::instance().add_connection(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Connection::componentComplete()
+{
+    m_nchannels = std::min(m_source->nchannels(), m_dest->nchannels());
     m_mul = m_source->mul() * m_dest->mul();
     m_add = m_source->add() + m_dest->add();
     m_muted = m_source->muted() || m_dest->muted();
 }
 
+// ------------------------------------------------------------------------------------------------
+void
+Connection::set_active(bool active) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    if (active == m_active.load())
+        return;
+
+    m_active = active;
+    Graph::instance().update();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Connection::set_muted(bool muted) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    if (muted == m_muted.load())
+        return;
+
+    m_muted = muted;
+
+    // an aliased Connection can't be muted in place, dest Port needs its own buffers back
+    // and source Nodes may have to be suspended/resumed (see Graph::suspend)
+    if (m_active && (wpn114::mix::select(m_mul, m_add) == wpn114::mix::Accumulate ||
+        Graph::instance().suspend()))
+        Graph::instance().update();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Connection::set_mul(sample_t mul) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    auto variant = wpn114::mix::select(m_mul, m_add);
+    m_mul = mul;
+
+    if (wpn114::mix::select(mul, m_add) != variant)
+        Graph::instance().update();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Connection::set_add(sample_t add) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    auto variant = wpn114::mix::select(m_mul, m_add);
+    m_add = add;
+
+    if (wpn114::mix::select(m_mul, add) != variant)
+        Graph::instance().update();
+}
+
+// ------------------------------------------------------------------------------------------------
+void
+Connection::set_routing(Routing matrix) noexcept
+// ------------------------------------------------------------------------------------------------
+{
+    m_routing = matrix;
+
+    if (m_active)
+        Graph::instance().update();
+}
+
 // ------------------------------------------------------------------------------------------------
 void
 Connection::update()
@@ -477,17 +3148,14 @@ Connection::update()
 
 // ------------------------------------------------------------------------------------------------
 WPN_AUDIOTHREAD void
-Connection::pull(vector_t nframes) noexcept
+Connection::pull(vector_t nframes, Routing::cable const* cables, nchannels_t ncables,
+                 wpn114::mix::variant variant, wpn114::mix::kernel kernel,
+                 audiobuffer_t source, bool reduced) noexcept
 // ------------------------------------------------------------------------------------------------
-{       
-    auto& source = m_source->parent_node();
-    // if source hasn't been processed yet in the current Graph run
-    // process it
-    if (!source.processed())
-        source.process(nframes);
-
+{
     // if connection is muted return
-    if (m_muted.load())
+    // reductions already hold the muted Connections' sources as zeros (see Graph::reduce)
+    if (m_muted.load() && !reduced)
         return;
 
     // in the case of a MIDI connection
@@ -496,37 +3164,106 @@ Connection::pull(vector_t nframes) noexcept
         auto sbuf = m_source->buffer<midibuffer_t>();
         auto dbuf = m_dest->buffer<midibuffer_t>();
 
-        Routing routing = m_routing;
+        // merge midi events into dest buffer, sorted by frame
+        // whatever the number of Connections feeding it (see midibuffer::merge)
+        for (nchannels_t c = 0; c < ncables; ++c)
+             dbuf[cables[c][1]]->merge(*sbuf[cables[c][0]]);
+        return;
+    }
+
+    // Midi 2.0 connection: packets are merged, sorted by frame
+    if (m_source->type() == Port::Midi_2_0)
+    {
+        auto sbuf = m_source->buffer<umpbuffer_t>();
+        auto dbuf = m_dest->buffer<umpbuffer_t>();
 
-        // append midi events to dest buffer
-        // (without intermediate copy)
-        if (routing.null())
-            for (nchannels_t c = 0; c < m_nchannels; ++c)
-                for (auto& mt : *sbuf[c])
-                     dbuf[c]->push(mt);
-        else
-            for (nchannels_t c = 0; c < routing.ncables(); ++c)
-                for (auto& mt : *sbuf[routing[c][0]])
-                     dbuf[routing[c][1]]->push(mt);
+        for (nchannels_t c = 0; c < ncables; ++c)
+             dbuf[cables[c][1]]->merge(*sbuf[cables[c][0]]);
+        return;
+    }
+
+    // sparse connection: sorted event lists are merged, values scaled by mul/add
+    if (m_source->sparse())
+    {
+        auto sbuf = m_source->buffer<eventbuffer_t>();
+        auto dbuf = m_dest->buffer<eventbuffer_t>();
+        sample_t mul = m_mul, add = m_add;
+
+        for (nchannels_t c = 0; c < ncables; ++c)
+             dbuf[cables[c][1]]->merge(*sbuf[cables[c][0]], mul, add);
+        return;
+    }
+
+    sample_t mul = reduced ? 1 : m_mul.load(), add = reduced ? 0 : m_add.load();
+
+    // Control dest: a value and a ramp are mixed per cable, whatever the number of frames
+    if (m_dest->type() == Port::Control)
+    {
+        auto dbuf = m_dest->buffer<controlbuffer_t>();
+
+        for (nchannels_t c = 0; c < ncables; ++c)
+        {
+            auto cable = cables[c];
+            control_t value;
+
+            if (m_source->type() == Port::Control)
+                value = m_source->buffer<controlbuffer_t>()[cable[0]];
+            else {
+                if (add == 0 && source == nullptr && m_source->silent(cable[0]))
+                    continue;
+                // Audio source is decimated to a ramp from its first frame to its last one
+                auto channel = (source ? source : m_source->buffer<audiobuffer_t>())[cable[0]];
+                value.value = channel[0];
+                value.ramp = nframes > 1 ? (channel[nframes-1]-channel[0])/(nframes-1) : 0;
+            }
+
+            dbuf[cable[1]].value += value.value*mul+add;
+            dbuf[cable[1]].ramp += value.ramp*mul;
+        }
         return;
     }
 
-    // else Audio connection
     auto dbuf = m_dest->buffer<audiobuffer_t>();
-    auto sbuf = m_source->buffer<audiobuffer_t>();
 
-    sample_t mul = m_mul, add = m_add;
-    Routing routing = m_routing;
+    // Control source, Audio dest: value is interpolated along its ramp
+    if (m_source->type() == Port::Control)
+    {
+        auto sbuf = m_source->buffer<controlbuffer_t>();
+
+        for (nchannels_t c = 0; c < ncables; ++c)
+        {
+            auto cable = cables[c];
+            auto channel = dbuf[cable[1]];
+            sample_t value = sbuf[cable[0]].value*mul+add, ramp = sbuf[cable[0]].ramp*mul;
+
+            if (value == 0 && ramp == 0)
+                continue;
 
-    // if routing hasn't been explicitely set
-    if (routing.null())
-        for (nchannels_t c = 0; c < m_nchannels; ++c)
             for (vector_t f = 0; f < nframes; ++f)
-                dbuf[c][f] += sbuf[c][f] * mul + add;           
-    else
-        for (nchannels_t c = 0; c < routing.ncables(); ++c)
-            for (vector_t f = 0; f < nframes; ++f) {
-                auto cable = routing[c];
-                dbuf[cable[1]][f] += sbuf[cable[0]][f] * mul + add;
-            }
+                 channel[f] += value+ramp*f;
+
+            m_dest->set_silent(cable[1], false);
+        }
+        return;
+    }
+
+    // else Audio connection
+    auto sbuf = source ? source : m_source->buffer<audiobuffer_t>();
+
+    // mul/add may have changed since the plan has been compiled,
+    // fall back to the general kernel until the next one is published
+    if (kernel == nullptr || (wpn114::mix::select(mul, add) | variant) != variant)
+        kernel = wpn114::mix::get(wpn114::mix::Affine);
+
+    for (nchannels_t c = 0; c < ncables; ++c)
+    {
+        auto cable = cables[c];
+
+        // silent source channel: there's nothing to mix, unless an offset has to be added
+        if (add == 0 && source == nullptr && m_source->silent(cable[0]))
+            continue;
+
+        kernel(dbuf[cable[1]], sbuf[cable[0]], mul, add, nframes);
+        m_dest->set_silent(cable[1], false);
+    }
 }
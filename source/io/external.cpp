@@ -37,25 +37,6 @@ External::componentComplete()
 }
 
 
-template<typename T> void
-IOBase::link_proxy(IOProxy* proxy)
-{
-    auto proxy_channels = proxy->channel_vector();
-    auto proxy_buffer = new T[proxy_channels.count()];
-    auto io_buffer = default_port(m_polarity)->buffer<T*>();
-
-    nchannels_t n = 0;
-
-    for (const auto& channel : proxy_channels) {
-        proxy_buffer[n] = io_buffer[channel];
-        n++;
-    }
-
-    auto proxy_port = proxy->default_port((Port::Type) proxy->type(), m_polarity);
-    proxy_port->set_buffer<T*>(proxy_buffer);
-}
-
-
 void
 IOBase::on_graph_complete(Graph::properties const& properties)
 {
@@ -72,6 +53,8 @@ IOBase::on_graph_complete(Graph::properties const& properties)
     if (m_nchannels > 0)
         m_nchannels++;
 
+    // read/written by the backend, outside of the Graph's plan
+    default_port(m_polarity)->set_persistent(true);
     default_port(m_polarity)->set_nchannels(m_nchannels);
     qDebug() << "[IO]" << m_name <<"-"<< m_nchannels << "channels";
     Node::on_graph_complete(properties);
@@ -84,8 +67,17 @@ IOBase::initialize(Graph::properties const& properties)
     for (auto& proxy : m_proxies) {
         auto type = proxy->type();
         switch(type) {
-        case IOProxy::Audio: link_proxy<sample_t*>(proxy); break;
-        case IOProxy::Midi: link_proxy<midibuffer*>(proxy);
+        case IOProxy::Audio: {
+            // Audio buffers are laid out by the Graph, they may move
+            auto port = proxy->default_port(Port::Audio, m_polarity);
+            port->link(*default_port(m_polarity), proxy->channel_vector());
+            break;
+        }
+        case IOProxy::Midi: {
+            // midibuffers may be replaced by larger ones, for plans with larger blocks
+            auto port = proxy->default_port(Port::Midi_1_0, m_polarity);
+            port->share(*default_port(m_polarity), proxy->channel_vector());
+        }
         }
     }
 }
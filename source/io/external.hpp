@@ -123,9 +123,6 @@ public:
     void
     add_proxy(IOProxy& proxy) { m_proxies.push_back(&proxy); }
 
-    template<typename T> void
-    link_proxy(IOProxy* proxy);
-
     virtual void
     on_graph_complete(const Graph::properties &properties) override;
 
@@ -198,6 +195,7 @@ public:
     {
         m_name = "audio_outputs";
         m_polarity = Polarity::Input;
+        m_sink = true;
     }
 };
 
@@ -214,6 +212,7 @@ public:
     {
         m_name = "midi_outputs";
         m_polarity = Polarity::Input;
+        m_sink = true;
     }
 };
 
@@ -337,6 +336,46 @@ public:
             m_backend->stop();
     }
 
+    //-------------------------------------------------------------------------------------------------
+    template<typename Inputs, typename Outputs> WPN_AUDIOTHREAD void
+    process(vector_t nframes, Inputs&& inputs, Outputs&& outputs) noexcept
+    // called by the backends for each of their periods, runs the Graph as many times as needed
+    // inputs(offset, position, n) and outputs(offset, position, n) exchange n frames,
+    // from offset in the backend's period, with position in the Graph's i/o buffers
+    // - period is a multiple of the Graph's block: blocks are processed in place, no latency
+    // - otherwise, outputs are read from the previous block, as inputs fill up the current one:
+    //   this adds a block of latency (see Graph::block)
+    //-------------------------------------------------------------------------------------------------
+    {
+        auto& graph = Graph::instance();
+
+        for (vector_t offset = 0; offset < nframes;)
+        {
+            if (m_position == 0)
+                m_block = std::max<vector_t>(graph.next(), 1);
+
+            auto n = std::min<vector_t>(nframes-offset, m_block-m_position);
+            bool direct = m_position == 0 && n == m_block && nframes % m_block == 0;
+
+            inputs(offset, m_position, n);
+
+            if (!direct)
+                outputs(offset, m_position, n);
+
+            m_position += n;
+
+            if (m_position == m_block) {
+                auto rendered = graph.run();
+                m_position = 0;
+                if (direct)
+                    // a new plan may have been picked up, with a different block size
+                    outputs(offset, 0, std::min(n, rendered));
+            }
+
+            offset += n;
+        }
+    }
+
     //-------------------------------------------------------------------------------------------------
     void
     on_rate_changed(sample_t rate) { m_backend->on_sample_rate_changed(rate); }
@@ -403,6 +442,11 @@ private:
     Backend::Values
     m_backend_id = Backend::None;
 
+    //---------------------------------------------------------------------------------------------
+    vector_t
+    m_position = 0,
+    m_block = 0;
+    // current frame in the Graph's block, and block size (audio thread, see process)
 };
 
 //=================================================================================================
@@ -589,7 +633,12 @@ class OutputProxy : public IOProxy
 public:
 
     //---------------------------------------------------------------------------------------------
-    OutputProxy() { m_name = "output_proxy"; }
+    OutputProxy()
+    //---------------------------------------------------------------------------------------------
+    {
+        m_name = "output_proxy";
+        m_sink = true;
+    }
 
     //---------------------------------------------------------------------------------------------
     virtual void
@@ -6,9 +6,15 @@ int
 JackExternal::on_jack_sample_rate_changed(jack_nframes_t rate, void* udata)
 // static callback, from jack whenever sample rate has changed
 // we update the graph, which will in turn notify registered Nodes of this change
+// this is called from one of jack's threads: like buffer size changes, it is queued
+// on the Graph's thread, where culled Nodes are tracked (see Graph::compile)
 //-------------------------------------------------------------------------------------------------
 {
-    Graph::instance().set_rate(rate);
+    auto& graph = Graph::instance();
+    QMetaObject::invokeMethod(&graph, [&graph, rate] {
+        graph.set_rate(rate);
+    }, Qt::QueuedConnection);
+
     return 0;
 }
 
@@ -17,9 +23,15 @@ int
 JackExternal::on_jack_buffer_size_changed(jack_nframes_t nframes, void* udata)
 // static callback, from jack whenever io buffer size has changed
 // we update the graph, which will in turn notify registered Nodes of this change
+// this is called from one of jack's threads: the change is queued on the Graph's thread,
+// where plans are compiled, the current plan keeps running until the new one is published
 //-------------------------------------------------------------------------------------------------
 {
-    Graph::instance().set_vector(nframes);
+    auto& graph = Graph::instance();
+    QMetaObject::invokeMethod(&graph, [&graph, nframes] {
+        graph.set_period(nframes);
+    }, Qt::QueuedConnection);
+
     return 0;
 }
 
@@ -32,103 +44,149 @@ JackExternal::on_jack_client_registration(const char* name, int reg, void* udata
     qDebug() << QString(name);
 }
 
+//-------------------------------------------------------------------------------------------------
+void
+JackExternal::on_jack_latency(jack_latency_callback_mode_t mode, void* udata)
+// static callback, from jack whenever port latencies have to be recomputed
+// the Graph's latency (see Graph::stages) is added to the one of the other side's ports
+//-------------------------------------------------------------------------------------------------
+{
+    auto& j_ext = *static_cast<JackExternal*>(udata);
+    jack_nframes_t latency = Graph::instance().latency();
+    jack_latency_range_t range = { 0, 0 };
+
+    // capture latency goes downstream: from our inputs to our outputs
+    // playback latency goes upstream: from our outputs to our inputs
+    bool capture = mode == JackCaptureLatency;
+    auto& audio_from = capture ? j_ext.m_audio_input_ports : j_ext.m_audio_output_ports;
+    auto& midi_from  = capture ? j_ext.m_midi_input_ports : j_ext.m_midi_output_ports;
+    auto& audio_to   = capture ? j_ext.m_audio_output_ports : j_ext.m_audio_input_ports;
+    auto& midi_to    = capture ? j_ext.m_midi_output_ports : j_ext.m_midi_input_ports;
+
+    for (auto& ports : { &audio_from, &midi_from })
+        for (auto& port : *ports) {
+            jack_latency_range_t r;
+            jack_port_get_latency_range(port, mode, &r);
+            range.min = std::max(range.min, r.min);
+            range.max = std::max(range.max, r.max);
+        }
+
+    range.min += latency;
+    range.max += latency;
+
+    for (auto& ports : { &audio_to, &midi_to })
+        for (auto& port : *ports)
+             jack_port_set_latency_range(port, mode, &range);
+}
+
 //-------------------------------------------------------------------------------------------------
 int
 JackExternal::jack_process_callback(jack_nframes_t nframes, void* udata)
 // run the graph for a certain amount of frames
 // copy the graph's final output into the jack output buffer
+// periods may be cut into, or accumulated up to the graph's blocks (see External::process)
 //-------------------------------------------------------------------------------------------------
 {
     auto& j_ext = *static_cast<JackExternal*>(udata);
     auto& ext = j_ext.parent();
 
-    //---------------------------------------------------------------------------------------------
-    // AUDIO_INPUTS
-    //---------------------------------------------------------------------------------------------
-    {
-        auto buffer = ext.audio_inputs().buffer<audiobuffer_t>();
-        auto ports  = j_ext.m_audio_input_ports;
+    // midi output buffers are filled along the way, in order
+    for (auto& j_out : j_ext.m_midi_output_ports)
+         jack_midi_clear_buffer(jack_port_get_buffer(j_out, nframes));
 
-        for (nchannels_t c = 0; c < ports.size(); ++c)
+    ext.process(nframes,
+    [&](vector_t offset, vector_t position, vector_t n)
+    {
+        //-----------------------------------------------------------------------------------------
+        // AUDIO_INPUTS
+        //-----------------------------------------------------------------------------------------
         {
-            auto j_in = ports[c];
-            auto j_buf = static_cast<sample_t*>(jack_port_get_buffer(j_in, nframes));
+            auto buffer = ext.audio_inputs().buffer<audiobuffer_t>();
+            auto& ports = j_ext.m_audio_input_ports;
 
-            for (jack_nframes_t f = 0; f < nframes; ++f)
-                 buffer[c][f] = j_buf[f];
-        }
-    }
+            for (nchannels_t c = 0; c < ports.size(); ++c)
+            {
+                auto j_in = ports[c];
+                auto j_buf = static_cast<sample_t*>(jack_port_get_buffer(j_in, nframes));
 
-    //---------------------------------------------------------------------------------------------
-    // MIDI_INPUTS
-    //---------------------------------------------------------------------------------------------
-    {
-        auto buffer = ext.midi_inputs().buffer<midibuffer_t>();
-        auto ports = j_ext.m_midi_input_ports;
-        jack_midi_event_t mevent;
+                for (vector_t f = 0; f < n; ++f)
+                     buffer[c][position+f] = j_buf[offset+f];
+            }
+        }
 
-        for (nchannels_t c = 0; c < ports.size(); ++c)
+        //-----------------------------------------------------------------------------------------
+        // MIDI_INPUTS
+        //-----------------------------------------------------------------------------------------
         {
-            auto j_in = ports[c];
-            auto j_bf = jack_port_get_buffer(j_in, nframes);
-            auto n_ev = jack_midi_get_event_count(j_bf);
+            auto buffer = ext.midi_inputs().buffer<midibuffer_t>();
+            auto& ports = j_ext.m_midi_input_ports;
+            jack_midi_event_t mevent;
+
+            for (nchannels_t c = 0; c < ports.size(); ++c)
+            {
+                auto j_in = ports[c];
+                auto j_bf = jack_port_get_buffer(j_in, nframes);
+                auto n_ev = jack_midi_get_event_count(j_bf);
 
-            for (jack_nframes_t f = 0; f < nframes; ++f) {
+                // events are sorted by time
                 for (jack_nframes_t e = 0; e < n_ev; ++e)
                 {
                     jack_midi_event_get(&mevent, j_bf, e);
-                    if (mevent.time == f) {
-                        midi_t* mt = buffer[c]->reserve(mevent.size-1);
-                        mt->frame  = mevent.time;
+                    if (mevent.time < offset || mevent.time >= offset+n)
+                        continue;
+
+                    if (midi_t* mt = buffer[c]->reserve(mevent.size-1)) {
+                        mt->frame  = position+mevent.time-offset;
                         mt->status = mevent.buffer[0];
                         memcpy(mt->data, &(mevent.buffer[1]), mevent.size-1);
                     }
                 }
             }
         }
-    }
-
-    //---------------------------------------------------------------------------------------------
-    // process the internal graph
-    Graph::instance().run();
-
-    //---------------------------------------------------------------------------------------------
-    // AUDIO_OUTPUTS
-    //---------------------------------------------------------------------------------------------
+    },
+    [&](vector_t offset, vector_t position, vector_t n)
     {
-        auto buffer = ext.audio_outputs().buffer<audiobuffer_t>();
-        auto ports = j_ext.m_audio_output_ports;
-
-        for (nchannels_t c = 0; c < ports.size(); ++c)
+        //-----------------------------------------------------------------------------------------
+        // AUDIO_OUTPUTS
+        //-----------------------------------------------------------------------------------------
         {
-            auto j_out = ports[c];
-            auto j_buf = static_cast<sample_t*>(jack_port_get_buffer(j_out, nframes));
+            auto buffer = ext.audio_outputs().buffer<audiobuffer_t>();
+            auto& ports = j_ext.m_audio_output_ports;
 
-            for (jack_nframes_t f = 0; f < nframes; ++f)
-                 j_buf[f] = buffer[c][f];
-        }
-    }
+            for (nchannels_t c = 0; c < ports.size(); ++c)
+            {
+                auto j_out = ports[c];
+                auto j_buf = static_cast<sample_t*>(jack_port_get_buffer(j_out, nframes));
 
-    //---------------------------------------------------------------------------------------------
-    // MIDI_OUTPUTS
-    //---------------------------------------------------------------------------------------------
-    {
-        auto buffer = ext.midi_outputs().buffer<midibuffer_t>();
-        auto ports = j_ext.m_midi_output_ports;
+                for (vector_t f = 0; f < n; ++f)
+                     j_buf[offset+f] = buffer[c][position+f];
+            }
+        }
 
-        for (nchannels_t c = 0; c < ports.size(); ++c)
+        //-----------------------------------------------------------------------------------------
+        // MIDI_OUTPUTS
+        //-----------------------------------------------------------------------------------------
         {
-            auto j_out = ports[c];
-            auto j_buf = jack_port_get_buffer(j_out, nframes);
-            jack_midi_clear_buffer(j_buf);
-
-            for (auto& mt : *buffer[c]) {
-                auto ev = jack_midi_event_reserve(j_buf, mt.frame, mt.nbytes+1);
-                memcpy(&(ev[1]), mt.data, mt.nbytes);
-                ev[0] = mt.status;
+            auto buffer = ext.midi_outputs().buffer<midibuffer_t>();
+            auto& ports = j_ext.m_midi_output_ports;
+
+            for (nchannels_t c = 0; c < ports.size(); ++c)
+            {
+                auto j_out = ports[c];
+                auto j_buf = jack_port_get_buffer(j_out, nframes);
+
+                for (auto& mt : *buffer[c]) {
+                    if (mt.frame < position || mt.frame >= position+n)
+                        continue;
+                    auto ev = jack_midi_event_reserve(j_buf, offset+mt.frame-position, mt.nbytes+1);
+                    if (ev == nullptr)
+                        continue;
+                    memcpy(&(ev[1]), mt.data, mt.nbytes);
+                    ev[0] = mt.status;
+                }
             }
         }
-    }
+    });
 
     return 0;
 }
@@ -219,7 +277,7 @@ JackExternal::JackExternal(External* parent) : m_parent(*parent)
     fprintf(stdout, "[JACK] samplerate: %d, buffer size: %d", srate, bsize);
 
     Graph::instance().set_rate(srate);
-    Graph::instance().set_vector(bsize);
+    Graph::instance().set_period(bsize);
 
     // set callbacks
     jack_set_sample_rate_callback(m_client,
@@ -234,6 +292,13 @@ JackExternal::JackExternal(External* parent) : m_parent(*parent)
     jack_set_client_registration_callback(m_client,
         on_jack_client_registration, this);
 
+    jack_set_latency_callback(m_client,
+        on_jack_latency, this);
+
+    // pipelined graphs: latency may change with each new execution plan
+    m_latency_connection = QObject::connect(&Graph::instance(), &Graph::latencyChanged,
+        [this](int) { jack_recompute_total_latencies(m_client); });
+
     auto n_audio_inputs     = m_parent.audio_inputs().nchannels();
     auto n_midi_inputs      = m_parent.midi_inputs().nchannels();
     auto n_audio_outputs    = m_parent.audio_outputs().nchannels();
@@ -39,6 +39,14 @@ class JackExternal : public ExternalBase
     static void
     on_jack_client_registration(const char* name, int reg, void* udata);
 
+    //---------------------------------------------------------------------------------------------
+    static void
+    on_jack_latency(jack_latency_callback_mode_t mode, void* udata);
+
+    //---------------------------------------------------------------------------------------------
+    QMetaObject::Connection
+    m_latency_connection;
+
 public:
 
     //---------------------------------------------------------------------------------------------
@@ -49,6 +57,7 @@ public:
     ~JackExternal() override
     //---------------------------------------------------------------------------------------------
     {
+        QObject::disconnect(m_latency_connection);
         jack_deactivate(m_client);
         jack_client_close(m_client);
     }
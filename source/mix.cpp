@@ -0,0 +1,325 @@
+#include <wpn114audio/mix.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define WPN_MIX_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+    #endif
+#endif
+
+// kernels have to produce the exact same output on all instruction sets:
+// multiplications and additions must not be fused
+#if defined(__clang__)
+    #pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+    #pragma GCC optimize ("fp-contract=off")
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define WPN_TARGET(_isa)
+#else
+    #define WPN_TARGET(_isa) __attribute__((target(_isa)))
+#endif
+
+namespace wpn114 {
+namespace mix {
+
+//-------------------------------------------------------------------------------------------------
+template<variant V> static inline sample_t
+apply(sample_t dest, sample_t source, sample_t mul, sample_t add) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    if constexpr (V == Scale || V == Affine)
+        source = source*mul;
+    if constexpr (V == Offset || V == Affine)
+        source = source+add;
+
+    return dest+source;
+}
+
+//-------------------------------------------------------------------------------------------------
+template<variant V> static void
+scalar(sample_t* dest, sample_t const* source, sample_t mul, sample_t add, vector_t nframes) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    for (vector_t f = 0; f < nframes; ++f)
+         dest[f] = apply<V>(dest[f], source[f], mul, add);
+}
+
+//-------------------------------------------------------------------------------------------------
+static bool
+zero_scalar(sample_t const* buffer, vector_t nframes) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    for (vector_t f = 0; f < nframes; ++f)
+        if (buffer[f] != 0)
+            return false;
+
+    return true;
+}
+
+#ifdef WPN_MIX_X86
+//-------------------------------------------------------------------------------------------------
+template<variant V> WPN_TARGET("sse2") static void
+sse2(sample_t* dest, sample_t const* source, sample_t mul, sample_t add, vector_t nframes) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    auto m = _mm_set1_ps(mul), a = _mm_set1_ps(add);
+    int f = 0;
+
+    for (; f+4 <= nframes; f += 4) {
+        auto s = _mm_loadu_ps(source+f);
+        if constexpr (V == Scale || V == Affine)
+            s = _mm_mul_ps(s, m);
+        if constexpr (V == Offset || V == Affine)
+            s = _mm_add_ps(s, a);
+        _mm_storeu_ps(dest+f, _mm_add_ps(_mm_loadu_ps(dest+f), s));
+    }
+
+    for (; f < nframes; ++f)
+         dest[f] = apply<V>(dest[f], source[f], mul, add);
+}
+
+//-------------------------------------------------------------------------------------------------
+template<variant V> WPN_TARGET("avx2") static void
+avx2(sample_t* dest, sample_t const* source, sample_t mul, sample_t add, vector_t nframes) noexcept
+// two independent 8-lane streams per iteration, to hide the add latency
+//-------------------------------------------------------------------------------------------------
+{
+    auto m = _mm256_set1_ps(mul), a = _mm256_set1_ps(add);
+    int f = 0;
+
+    for (; f+16 <= nframes; f += 16) {
+        auto s0 = _mm256_loadu_ps(source+f);
+        auto s1 = _mm256_loadu_ps(source+f+8);
+        if constexpr (V == Scale || V == Affine) {
+            s0 = _mm256_mul_ps(s0, m);
+            s1 = _mm256_mul_ps(s1, m);
+        }
+        if constexpr (V == Offset || V == Affine) {
+            s0 = _mm256_add_ps(s0, a);
+            s1 = _mm256_add_ps(s1, a);
+        }
+        _mm256_storeu_ps(dest+f, _mm256_add_ps(_mm256_loadu_ps(dest+f), s0));
+        _mm256_storeu_ps(dest+f+8, _mm256_add_ps(_mm256_loadu_ps(dest+f+8), s1));
+    }
+
+    for (; f < nframes; ++f)
+         dest[f] = apply<V>(dest[f], source[f], mul, add);
+}
+
+//-------------------------------------------------------------------------------------------------
+template<variant V> WPN_TARGET("avx512f") static void
+avx512(sample_t* dest, sample_t const* source, sample_t mul, sample_t add, vector_t nframes) noexcept
+// the remaining frames are processed with a masked iteration
+//-------------------------------------------------------------------------------------------------
+{
+    auto m = _mm512_set1_ps(mul), a = _mm512_set1_ps(add);
+    int f = 0;
+
+    for (; f+16 <= nframes; f += 16) {
+        auto s = _mm512_loadu_ps(source+f);
+        if constexpr (V == Scale || V == Affine)
+            s = _mm512_mul_ps(s, m);
+        if constexpr (V == Offset || V == Affine)
+            s = _mm512_add_ps(s, a);
+        _mm512_storeu_ps(dest+f, _mm512_add_ps(_mm512_loadu_ps(dest+f), s));
+    }
+
+    if (f < nframes) {
+        auto mask = static_cast<__mmask16>((1u << (nframes-f))-1);
+        auto s = _mm512_maskz_loadu_ps(mask, source+f);
+        if constexpr (V == Scale || V == Affine)
+            s = _mm512_mul_ps(s, m);
+        if constexpr (V == Offset || V == Affine)
+            s = _mm512_add_ps(s, a);
+        _mm512_mask_storeu_ps(dest+f, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, dest+f), s));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+WPN_TARGET("sse2") static bool
+zero_sse2(sample_t const* buffer, vector_t nframes) noexcept
+// unordered comparison: NaNs are not zero
+//-------------------------------------------------------------------------------------------------
+{
+    auto z = _mm_setzero_ps();
+    int f = 0;
+
+    for (; f+4 <= nframes; f += 4)
+        if (_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(buffer+f), z)))
+            return false;
+
+    for (; f < nframes; ++f)
+        if (buffer[f] != 0)
+            return false;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+WPN_TARGET("avx2") static bool
+zero_avx2(sample_t const* buffer, vector_t nframes) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    auto z = _mm256_setzero_ps();
+    int f = 0;
+
+    for (; f+16 <= nframes; f += 16) {
+        auto n0 = _mm256_cmp_ps(_mm256_loadu_ps(buffer+f), z, _CMP_NEQ_UQ);
+        auto n1 = _mm256_cmp_ps(_mm256_loadu_ps(buffer+f+8), z, _CMP_NEQ_UQ);
+        if (_mm256_movemask_ps(_mm256_or_ps(n0, n1)))
+            return false;
+    }
+
+    for (; f < nframes; ++f)
+        if (buffer[f] != 0)
+            return false;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+WPN_TARGET("avx512f") static bool
+zero_avx512(sample_t const* buffer, vector_t nframes) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    auto z = _mm512_setzero_ps();
+    int f = 0;
+
+    for (; f+16 <= nframes; f += 16)
+        if (_mm512_cmp_ps_mask(_mm512_loadu_ps(buffer+f), z, _CMP_NEQ_UQ))
+            return false;
+
+    if (f < nframes) {
+        auto mask = static_cast<__mmask16>((1u << (nframes-f))-1);
+        if (_mm512_mask_cmp_ps_mask(mask, _mm512_maskz_loadu_ps(mask, buffer+f), z, _CMP_NEQ_UQ))
+            return false;
+    }
+
+    return true;
+}
+#endif
+
+//-------------------------------------------------------------------------------------------------
+static isa
+detect() noexcept
+//-------------------------------------------------------------------------------------------------
+{
+#if defined(WPN_MIX_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    auto nids = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = info[3] & (1 << 26);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+
+    // the os has to save the extended registers on context switches
+    auto xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool avx2 = false, avx512 = false;
+
+    if (nids >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = info[1] & (1 << 5);
+        avx512 = info[1] & (1 << 16);
+    }
+
+    if (avx512 && (xcr0 & 0xe6) == 0xe6)
+        return isa::AVX512;
+    if (avx2 && avx && (xcr0 & 0x6) == 0x6)
+        return isa::AVX2;
+    if (sse2)
+        return isa::SSE2;
+#elif defined(WPN_MIX_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return isa::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return isa::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return isa::SSE2;
+#endif
+    return isa::Scalar;
+}
+
+//-------------------------------------------------------------------------------------------------
+static const isa
+s_isa = detect();
+
+static const kernel
+s_kernels[4][4] =
+//-------------------------------------------------------------------------------------------------
+{
+    { scalar<Accumulate>, scalar<Scale>, scalar<Offset>, scalar<Affine> },
+#ifdef WPN_MIX_X86
+    { sse2<Accumulate>, sse2<Scale>, sse2<Offset>, sse2<Affine> },
+    { avx2<Accumulate>, avx2<Scale>, avx2<Offset>, avx2<Affine> },
+    { avx512<Accumulate>, avx512<Scale>, avx512<Offset>, avx512<Affine> }
+#else
+    { nullptr, nullptr, nullptr, nullptr },
+    { nullptr, nullptr, nullptr, nullptr },
+    { nullptr, nullptr, nullptr, nullptr }
+#endif
+};
+
+using zero_t = bool(*)(sample_t const*, vector_t) noexcept;
+
+static const zero_t
+s_zero[4] =
+//-------------------------------------------------------------------------------------------------
+{
+    zero_scalar,
+#ifdef WPN_MIX_X86
+    zero_sse2, zero_avx2, zero_avx512
+#else
+    nullptr, nullptr, nullptr
+#endif
+};
+
+//-------------------------------------------------------------------------------------------------
+isa
+current() noexcept { return s_isa; }
+
+//-------------------------------------------------------------------------------------------------
+kernel
+get(variant v) noexcept { return s_kernels[static_cast<uint8_t>(s_isa)][v]; }
+
+//-------------------------------------------------------------------------------------------------
+kernel
+get(variant v, isa target) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    if (target > s_isa)
+        return nullptr;
+
+    return s_kernels[static_cast<uint8_t>(target)][v];
+}
+
+//-------------------------------------------------------------------------------------------------
+bool
+zero(sample_t const* buffer, vector_t nframes) noexcept
+{
+    return s_zero[static_cast<uint8_t>(s_isa)](buffer, nframes);
+}
+
+//-------------------------------------------------------------------------------------------------
+const char*
+name(isa target) noexcept
+//-------------------------------------------------------------------------------------------------
+{
+    switch(target) {
+    case isa::Scalar: return "scalar";
+    case isa::SSE2: return "sse2";
+    case isa::AVX2: return "avx2";
+    case isa::AVX512: return "avx512";
+    }
+
+    return "unknown";
+}
+
+}
+}
@@ -0,0 +1,102 @@
+#undef NDEBUG
+#include <wpn114audio/event.hpp>
+#include <cassert>
+#include <cstdio>
+#include <vector>
+#include <utility>
+
+// eventbuffer: Trigger/Gate events, pushed out of order and merged from several sources
+
+using event = std::pair<vector_t, sample_t>;
+
+//-------------------------------------------------------------------------------------------------
+static std::vector<event>
+events(eventbuffer& buffer)
+//-------------------------------------------------------------------------------------------------
+{
+    std::vector<event> events;
+
+    for (auto& e : buffer)
+         events.emplace_back(e.frame, e.value);
+
+    return events;
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+push()
+// events are inserted at their frame, after the ones sharing it
+//-------------------------------------------------------------------------------------------------
+{
+    eventbuffer buffer(4);
+
+    assert(buffer.push({ 10, 1 }));
+    assert(buffer.push({ 2, 2 }));
+    assert(buffer.push({ 10, 3 }));
+    assert(buffer.push({ 2, 4 }));
+    assert(!buffer.push({ 0, 5 }));
+
+    assert(events(buffer) == (std::vector<event>{ {2, 2}, {2, 4}, {10, 1}, {10, 3} }));
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+merge()
+// source values are scaled, events sharing the same frame keep their order, dest's ones first
+//-------------------------------------------------------------------------------------------------
+{
+    eventbuffer dest(16), source(16);
+    dest.push({ 0, 1 }); dest.push({ 5, 2 }); dest.push({ 9, 3 });
+    source.push({ 5, 1 }); source.push({ 7, 2 }); source.push({ 12, 3 });
+
+    assert(dest.merge(source, 2, 0.5) == 3);
+    assert(events(dest) == (std::vector<event>{ {0, 1}, {5, 2}, {5, 2.5}, {7, 4.5},
+                                                {9, 3}, {12, 6.5} }));
+
+    // source is left as is
+    assert(events(source) == (std::vector<event>{ {5, 1}, {7, 2}, {12, 3} }));
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+full()
+// the latest source events are dropped if they don't fit
+//-------------------------------------------------------------------------------------------------
+{
+    eventbuffer dest(4), source(4);
+    dest.push({ 2, 1 }); dest.push({ 8, 2 });
+    source.push({ 1, 3 }); source.push({ 4, 4 }); source.push({ 9, 5 });
+
+    assert(dest.merge(source) == 2);
+    assert(events(dest) == (std::vector<event>{ {1, 3}, {2, 1}, {4, 4}, {8, 2} }));
+    assert(dest.merge(source) == 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+empty()
+//-------------------------------------------------------------------------------------------------
+{
+    eventbuffer dest(4), source(4), none(4);
+    source.push({ 3, 1 }); source.push({ 6, 2 });
+
+    assert(dest.merge(none) == 0 && dest.empty());
+    assert(dest.merge(source) == 2);
+    assert(events(dest) == events(source));
+
+    dest.clear();
+    assert(dest.empty() && dest.count() == 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+int
+main()
+//-------------------------------------------------------------------------------------------------
+{
+    push();
+    merge();
+    full();
+    empty();
+    printf("eventbuffer: ok\n");
+    return 0;
+}
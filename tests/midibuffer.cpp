@@ -0,0 +1,134 @@
+#undef NDEBUG
+#include <wpn114audio/midi.hpp>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <utility>
+
+// midibuffer::merge: sources merged one after the other into a single frame-ordered stream
+
+using event = std::pair<vector_t, byte_t>;
+
+//-------------------------------------------------------------------------------------------------
+static void
+push(midibuffer& buffer, vector_t frame, byte_t id)
+// a note on, id (its note number) tells where it comes from
+//-------------------------------------------------------------------------------------------------
+{
+    auto mt = buffer.reserve(0x90, frame, id, 100);
+    assert(mt);
+}
+
+//-------------------------------------------------------------------------------------------------
+static std::vector<event>
+events(midibuffer& buffer)
+//-------------------------------------------------------------------------------------------------
+{
+    std::vector<event> events;
+
+    for (auto& mt : buffer)
+         events.emplace_back(mt.frame, mt.data[0]);
+
+    // offsets (operator[]) have to match the iterator
+    for (vector_t e = 0; e < buffer.count(); ++e)
+         assert(buffer[e]->frame == events[e].first && buffer[e]->data[0] == events[e].second);
+
+    assert(buffer[buffer.count()] == nullptr);
+    return events;
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+ties()
+// events sharing the same frame keep their order, dest's ones first
+//-------------------------------------------------------------------------------------------------
+{
+    midibuffer dest(1024), source(1024);
+    push(dest, 0, 1); push(dest, 5, 2); push(dest, 5, 3); push(dest, 10, 4);
+    push(source, 5, 11); push(source, 5, 12); push(source, 7, 13); push(source, 10, 14);
+
+    assert(dest.merge(source) == 4);
+    assert(dest.count() == 8);
+    assert(events(dest) == (std::vector<event>{ {0, 1}, {5, 2}, {5, 3}, {5, 11}, {5, 12},
+                                                {7, 13}, {10, 4}, {10, 14} }));
+
+    // source following dest's last event is appended
+    midibuffer tail(1024);
+    push(tail, 10, 21); push(tail, 12, 22);
+
+    assert(dest.merge(tail) == 2);
+    assert(events(dest).back() == event(12, 22));
+    assert(events(dest)[7] == event(10, 14) && events(dest)[8] == event(10, 21));
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+full()
+// the latest source events are dropped if they don't fit, dest remains sorted
+//-------------------------------------------------------------------------------------------------
+{
+    // 4 slots
+    midibuffer dest(sizeof(midi_t)*4), source(1024);
+    push(dest, 2, 1); push(dest, 8, 2);
+    push(source, 1, 11); push(source, 4, 12); push(source, 9, 13);
+
+    assert(dest.merge(source) == 2);
+    assert(events(dest) == (std::vector<event>{ {1, 11}, {2, 1}, {4, 12}, {8, 2} }));
+
+    // nothing fits anymore
+    assert(dest.merge(source) == 0);
+    assert(dest.count() == 4);
+
+    // a sysex message taking two slots, followed by a note that doesn't fit
+    byte_t sysex[10] = { 0x7e, 1, 2, 3, 4, 5, 6, 7, 8, 0xf7 };
+    midibuffer small(sizeof(midi_t)*3), long_source(1024);
+    push(small, 5, 1);
+    auto mt = long_source.reserve(sizeof(sysex), 0xf0, 1, sysex);
+    assert(mt);
+    push(long_source, 3, 12);
+    assert(midibuffer::nslots(sizeof(sysex)) == 2);
+
+    assert(small.merge(long_source) == 1);
+    assert(small.count() == 2);
+    assert(small[0]->status == 0xf0 && small[0]->nbytes == sizeof(sysex));
+    assert(memcmp(small[0]->data, sysex, sizeof(sysex)) == 0);
+    assert(small[1]->frame == 5 && small[1]->data[0] == 1);
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+empty()
+// merging into an empty dest copies source, merging an empty source does nothing
+//-------------------------------------------------------------------------------------------------
+{
+    midibuffer dest(1024), source(1024), none(1024);
+    push(source, 3, 11); push(source, 3, 12); push(source, 6, 13);
+
+    assert(dest.merge(none) == 0);
+    assert(dest.empty());
+
+    assert(dest.merge(source) == 3);
+    assert(events(dest) == events(source));
+
+    assert(dest.merge(none) == 0);
+    assert(dest.count() == 3);
+
+    // cleared buffers are empty dests again
+    dest.clear();
+    assert(dest.empty() && dest.count() == 0);
+    assert(dest.merge(source) == 3);
+    assert(events(dest) == events(source));
+}
+
+//-------------------------------------------------------------------------------------------------
+int
+main()
+//-------------------------------------------------------------------------------------------------
+{
+    ties();
+    full();
+    empty();
+    printf("midibuffer: ok\n");
+    return 0;
+}
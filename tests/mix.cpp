@@ -0,0 +1,90 @@
+#undef NDEBUG
+#include <wpn114audio/mix.hpp>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// mixing kernels: all instruction sets produce the exact same output as the scalar ones,
+// whatever the block size (vector loops and their scalar tails)
+
+using namespace wpn114;
+
+//-------------------------------------------------------------------------------------------------
+static void
+kernels()
+//-------------------------------------------------------------------------------------------------
+{
+    mix::variant variants[] = { mix::Accumulate, mix::Scale, mix::Offset, mix::Affine };
+    mix::isa targets[] = { mix::isa::SSE2, mix::isa::AVX2, mix::isa::AVX512 };
+    vector_t sizes[] = { 1, 3, 8, 17, 64, 67, 256 };
+
+    for (auto v : variants)
+    {
+        auto reference = mix::get(v, mix::isa::Scalar);
+        assert(reference);
+
+        for (auto nframes : sizes)
+        {
+            std::vector<sample_t> source(nframes), expected(nframes);
+
+            for (vector_t f = 0; f < nframes; ++f) {
+                source[f] = static_cast<sample_t>(f%7)*0.375f-1.f;
+                expected[f] = static_cast<sample_t>(f%5)*0.5f;
+            }
+
+            auto dest = expected;
+            reference(expected.data(), source.data(), 0.5f, 0.25f, nframes);
+
+            // exact values: dest += source*mul+add
+            for (vector_t f = 0; f < nframes; ++f) {
+                auto s = v == mix::Scale || v == mix::Affine ? source[f]*0.5f : source[f];
+                s = v == mix::Offset || v == mix::Affine ? s+0.25f : s;
+                assert(expected[f] == dest[f]+s);
+            }
+
+            for (auto target : targets)
+            {
+                auto kernel = mix::get(v, target);
+                if (kernel == nullptr)
+                    // not supported by this CPU or build
+                    continue;
+
+                auto result = dest;
+                kernel(result.data(), source.data(), 0.5f, 0.25f, nframes);
+                assert(memcmp(result.data(), expected.data(), sizeof(sample_t)*nframes) == 0);
+            }
+        }
+    }
+
+    assert(mix::get(mix::Affine) != nullptr);
+    assert(mix::select(1, 0) == mix::Accumulate && mix::select(2, 0) == mix::Scale);
+    assert(mix::select(1, 1) == mix::Offset && mix::select(2, 1) == mix::Affine);
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+zero()
+// a single non-zero sample, anywhere in the block, is detected
+//-------------------------------------------------------------------------------------------------
+{
+    std::vector<sample_t> buffer(67, 0);
+    assert(mix::zero(buffer.data(), 67));
+
+    for (vector_t f = 0; f < 67; ++f) {
+        buffer[f] = 1e-30f;
+        assert(!mix::zero(buffer.data(), 67));
+        buffer[f] = 0;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+int
+main()
+//-------------------------------------------------------------------------------------------------
+{
+    kernels();
+    zero();
+    printf("mix: ok (%s)\n", mix::name(mix::current()));
+    return 0;
+}
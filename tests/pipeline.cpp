@@ -0,0 +1,147 @@
+#undef NDEBUG
+#include <wpn114audio/graph.hpp>
+#include <source/basics/audio/vca.hpp>
+#include <QCoreApplication>
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// pipelined plans (see Graph::pipeline): the i/o output Nodes receive the exact same blocks
+// as with a single stage, delayed by the latency the Graph reports, a whole number of blocks
+
+using block = std::vector<sample_t>;
+
+//-------------------------------------------------------------------------------------------------
+class Source : public Node
+// an i/o input Node: no inputs, its output is persistent, it writes a ramp
+//-------------------------------------------------------------------------------------------------
+{
+public:
+    WPN_DECLARE_DEFAULT_AUDIO_OUTPUT(audio_out, 1)
+
+    Source()
+    {
+        m_name = "Source";
+        m_audio_out.set_persistent(true);
+    }
+
+    void
+    rwrite(pool&, pool& outputs, vector_t nframes) override
+    {
+        auto out = outputs.audio[0][0];
+        for (vector_t f = 0; f < nframes; ++f)
+             out[f] = static_cast<sample_t>(m_frame++ % 1024);
+    }
+
+private:
+    size_t
+    m_frame = 0;
+};
+
+//-------------------------------------------------------------------------------------------------
+class Sink : public Node
+// an i/o output Node: no outputs, its input is persistent, it records it block by block
+//-------------------------------------------------------------------------------------------------
+{
+public:
+    WPN_DECLARE_DEFAULT_AUDIO_INPUT(audio_in, 1)
+
+    Sink(std::vector<block>& blocks) : m_blocks(blocks)
+    {
+        m_name = "Sink";
+        m_sink = true;
+        m_audio_in.set_persistent(true);
+    }
+
+    void
+    rwrite(pool& inputs, pool&, vector_t nframes) override
+    {
+        auto in = inputs.audio[0][0];
+        m_blocks.emplace_back(in, in+nframes);
+    }
+
+private:
+    std::vector<block>&
+    m_blocks;
+};
+
+//-------------------------------------------------------------------------------------------------
+static int
+run(int threads, int stages, vector_t nframes, size_t nblocks, std::vector<block>& blocks)
+// a ramp going through a chain of VCAs, returns the Graph's latency
+//-------------------------------------------------------------------------------------------------
+{
+    Graph graph;
+    graph.set_vector(nframes);
+
+    Source source;
+    Sink sink(blocks);
+    std::vector<std::unique_ptr<VCA>> vcas;
+
+    source.componentComplete();
+    sink.componentComplete();
+
+    Port* previous = &source.m_audio_out;
+
+    for (int n = 0; n < 24; ++n) {
+        vcas.emplace_back(new VCA);
+        auto& vca = *vcas.back();
+        vca.m_audio_in.set_nchannels(1);
+        vca.m_audio_out.set_nchannels(1);
+        vca.m_gain.set_value(n % 2 ? 2 : 0.5);
+        vca.componentComplete();
+        graph.connect(*previous, vca.m_audio_in);
+        previous = &vca.m_audio_out;
+    }
+
+    graph.connect(*previous, sink.m_audio_in);
+    graph.set_threads(threads);
+    graph.set_stages(stages);
+    graph.componentComplete();
+
+    for (size_t b = 0; b < nblocks; ++b)
+         graph.run();
+
+    return graph.latency();
+}
+
+//-------------------------------------------------------------------------------------------------
+int
+main(int argc, char** argv)
+//-------------------------------------------------------------------------------------------------
+{
+    QCoreApplication app(argc, argv);
+
+    constexpr vector_t nframes = 128;
+    constexpr size_t nblocks = 64;
+    std::vector<block> reference;
+
+    auto latency = run(1, 1, nframes, nblocks, reference);
+    assert(latency == 0);
+    assert(reference.size() == nblocks);
+
+    for (auto configuration : { std::make_pair(2, 2), std::make_pair(4, 3), std::make_pair(4, 4) })
+    {
+        std::vector<block> blocks;
+        latency = run(configuration.first, configuration.second, nframes, nblocks, blocks);
+
+        // inputs are processed by the first stage, outputs by the last one
+        assert(latency > 0 && latency % nframes == 0);
+        assert(latency/nframes <= configuration.second-1);
+        assert(blocks.size() == nblocks);
+
+        size_t delay = latency/nframes;
+
+        for (size_t b = 0; b < delay; ++b)
+             assert(blocks[b] == block(nframes, 0));
+
+        for (size_t b = delay; b < nblocks; ++b)
+             assert(blocks[b] == reference[b-delay]);
+
+        printf("pipeline: %d stages, latency %d frames\n", configuration.second, latency);
+    }
+
+    printf("pipeline: ok\n");
+    return 0;
+}
@@ -0,0 +1,140 @@
+#undef NDEBUG
+#include <wpn114audio/ump.hpp>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// umpbuffer: conversions to and from midibuffer events, filters and merges
+
+//-------------------------------------------------------------------------------------------------
+static void
+roundtrip()
+// MIDI 1.0 channel voice, system and sysex messages come back unchanged
+//-------------------------------------------------------------------------------------------------
+{
+    byte_t sysex[10] = { 0x7e, 1, 2, 3, 4, 5, 6, 7, 8, 0xf7 };
+    midibuffer source(1024), dest(1024);
+
+    byte_t note_on[] = { 60, 100 }, program[] = { 5 }, note_off[] = { 60, 0 };
+    source.reserve(sizeof(note_on), 0x90, 1, note_on);
+    source.reserve(sizeof(program), 0xc3, 2, program);
+    source.reserve(sizeof(sysex), 0xf0, 3, sysex);
+    source.reserve(0, 0xf8, 4, sysex);
+    source.reserve(sizeof(note_off), 0x80, 5, note_off);
+
+    umpbuffer packets(64);
+
+    // the sysex message is split in two packets
+    assert(packets.read(source) == 6);
+    assert(packets.words(0)[2] >> 28 == umpbuffer::Data64);
+    assert(packets.words(0)[3] >> 28 == umpbuffer::Data64);
+
+    assert(packets.write(dest) == 5);
+    assert(dest.count() == source.count());
+
+    for (vector_t e = 0; e < source.count(); ++e) {
+        auto s = source[e], d = dest[e];
+        assert(s->frame == d->frame && s->status == d->status && s->nbytes == d->nbytes);
+        assert(memcmp(s->data, d->data, s->nbytes) == 0);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+midi2()
+// MIDI 2.0 channel voice messages are converted down to MIDI 1.0
+//-------------------------------------------------------------------------------------------------
+{
+    umpbuffer packets(16);
+    midibuffer dest(1024);
+
+    packets.push(0, umpbuffer::word(umpbuffer::Midi2, 0, 0x91, 64), 0x8000u << 16);
+    // velocities converted to zero remain note ons
+    packets.push(1, umpbuffer::word(umpbuffer::Midi2, 0, 0x91, 65), 0x0100u << 16);
+    packets.push(2, umpbuffer::word(umpbuffer::Midi2, 0, 0xe1), 0x80000000u);
+    // program change with a bank
+    packets.push(3, umpbuffer::word(umpbuffer::Midi2, 0, 0xc2, 0, 1), 7u << 24 | 2u << 8 | 3);
+
+    assert(packets.write(dest) == 6);
+
+    auto check = [&](vector_t e, vector_t frame, byte_t status, byte_t b1, byte_t b2) {
+        assert(dest[e]->frame == frame && dest[e]->status == status && dest[e]->data[0] == b1);
+        assert(dest[e]->nbytes < 2 || dest[e]->data[1] == b2);
+    };
+
+    check(0, 0, 0x91, 64, 64);
+    check(1, 1, 0x91, 65, 1);
+    check(2, 2, 0xe1, 0, 64);
+    check(3, 3, 0xb2, 0, 2);
+    check(4, 3, 0xb2, 32, 3);
+    check(5, 3, 0xc2, 7, 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+filter()
+// packets are kept (or dropped) by their first word's masked bits, in order
+//-------------------------------------------------------------------------------------------------
+{
+    umpbuffer packets(16);
+
+    // note offs and ons, alternately, on channels 0 to 3
+    for (vector_t f = 0; f < 8; ++f) {
+         byte_t status = (f % 2 ? 0x90 : 0x80) | f % 4;
+         packets.push(f, umpbuffer::word(umpbuffer::Midi1, 0, status, 60+f, 100));
+    }
+
+    // nothing to drop
+    assert(packets.filter(umpbuffer::type_mask, static_cast<uint32_t>(umpbuffer::Midi1) << 28) == 8);
+
+    // drops channel 3
+    assert(packets.filter(umpbuffer::channel_mask, 0x00030000, false) == 6);
+
+    // keeps the note ons on channel 1
+    auto mask = umpbuffer::status_mask|umpbuffer::channel_mask;
+    assert(packets.filter(mask, 0x00910000) == 2);
+    assert(packets.frames()[0] == 1 && packets.frames()[1] == 5);
+    assert((packets.words(0)[1] & umpbuffer::index_mask) >> 8 == 65);
+}
+
+//-------------------------------------------------------------------------------------------------
+static void
+merge()
+// same as midibuffer::merge: dest's packets first on equal frames, latest source ones dropped
+//-------------------------------------------------------------------------------------------------
+{
+    umpbuffer dest(5), source(4);
+    auto note = [](byte_t id) { return umpbuffer::word(umpbuffer::Midi1, 0, 0x90, id, 100); };
+
+    dest.push(0, note(1)); dest.push(5, note(2)); dest.push(9, note(3));
+    source.push(5, note(11)); source.push(6, note(12)); source.push(7, note(13));
+
+    assert(dest.merge(source) == 2);
+    assert(dest.count() == 5);
+
+    vector_t frames[] = { 0, 5, 5, 6, 9 };
+    byte_t ids[] = { 1, 2, 11, 12, 3 };
+
+    for (size_t p = 0; p < dest.count(); ++p)
+         assert(dest.frames()[p] == frames[p] && (dest.words(0)[p] >> 8 & 0xff) == ids[p]);
+
+    assert(dest.merge(source) == 0);
+
+    umpbuffer empty(4);
+    assert(empty.merge(source) == 3);
+    assert(empty.frames()[2] == 7);
+}
+
+//-------------------------------------------------------------------------------------------------
+int
+main()
+//-------------------------------------------------------------------------------------------------
+{
+    roundtrip();
+    midi2();
+    filter();
+    merge();
+    printf("umpbuffer: ok\n");
+    return 0;
+}